@@ -4,28 +4,170 @@ from PyQt5.QtCore import QThread, pyqtSignal
 import sys
 import subprocess
 import os
+import json
+import socket
+import tempfile
+import threading
+import time
+
+# Socket del modo servicio de main.c ("mpiexec ... ./main --servicio"); si está levantado
+# los trabajos se le envían en lugar de lanzar mpiexec cada vez. El servicio lee la caché
+# de su propio entorno: hay que levantarlo con las mismas variables que ENTORNO_CACHE, p. ej.
+#   FILTROS_CACHE_DIR=/home/mpiu/cache_filtros FILTROS_CACHE_MAX_MB=4096 mpiexec ... ./main --servicio
+RUTA_SERVICIO = os.environ.get("FILTROS_SERVICIO", "/tmp/filtros_servicio.sock")
+
+# Caché de resultados de main.c (cache_resultados.h): cada clic vuelve a copiar la carpeta
+# a img_gui y a pedir todos los filtros, así que las imágenes sin cambios se enlazan desde
+# la caché en lugar de recalcularse. Va junto a destinoBash, en su mismo sistema de
+# archivos, porque la caché solo guarda con enlaces duros. Se respetan valores ya definidos.
+ENTORNO_CACHE = {
+    "FILTROS_CACHE_DIR": "/home/mpiu/cache_filtros",
+    "FILTROS_CACHE_MAX_MB": "4096",
+}
+
+# Vista previa: nivel 2 de la pirámide (1/4 por lado); las salidas van a CARPETA_PREVIEW de main.c
+NIVEL_VISTA_PREVIA = 2
+CARPETA_VISTA_PREVIA = "/home/mpiu/destinoBash/preview"
+
+
+def kernel_vista_previa(kernel, nivel=NIVEL_VISTA_PREVIA):
+    # Mismo cálculo que piramide_kernel (piramide.h): el blur de la vista previa usa el radio
+    # escalado, aunque el archivo se llame con el kernel pedido
+    radio = max(((kernel // 2) + (1 << (nivel - 1))) >> nivel, 1)
+    return 2 * radio + 1
+
 
 class Worker(QThread):
     progreso = pyqtSignal(str)
     terminado = pyqtSignal(str)
     error = pyqtSignal(str)
     progreso_avance = pyqtSignal(int)
+    rendimiento = pyqtSignal(str)
 
-    def __init__(self, comando, reporte_path, total_esperado):
+    def __init__(self, comando, reporte_path, total_esperado, trabajo=None):
         super().__init__()
         self.comando = comando
         self.reporte_path = reporte_path
         self.total_esperado = total_esperado
+        self.trabajo = trabajo
+        self.eventos_conectados = False
+        self.fin_eventos = False
+
+    def escuchar_eventos(self, servidor):
+        # El proceso 0 se conecta y manda una línea JSON por salida generada (ver eventos.h)
+        while not self.fin_eventos:
+            try:
+                conexion, _ = servidor.accept()
+                break
+            except socket.timeout:
+                continue
+            except OSError:
+                return
+        else:
+            return
+
+        self.eventos_conectados = True
+        self.leer_eventos(conexion)
+
+    def leer_eventos(self, conexion):
+        # Devuelve el mensaje del registro "error", si llegó alguno
+        salidas_esperadas = self.total_esperado
+        completadas = 0
+        bytes_totales = 0
+        error = None
+        inicio = time.monotonic()
+        conexion.settimeout(None)
+        with conexion, conexion.makefile("r", encoding="utf-8", errors="replace") as canal:
+            for linea in canal:
+                try:
+                    evento = json.loads(linea)
+                except ValueError:
+                    continue
+
+                tipo = evento.get("tipo")
+                if tipo == "inicio":
+                    salidas_esperadas = evento.get("salidas") or salidas_esperadas
+                elif tipo == "salida":
+                    completadas += 1
+                    bytes_totales += evento.get("bytes", 0)
+                    if salidas_esperadas:
+                        self.progreso_avance.emit(min(int(completadas * 100 / salidas_esperadas), 100))
+                    transcurrido = max(time.monotonic() - inicio, 1e-6)
+                    self.rendimiento.emit(
+                        f"{completadas}/{salidas_esperadas} salidas · "
+                        f"{bytes_totales / 1048576 / transcurrido:.1f} MB/s · "
+                        f"{evento.get('imagen', '')} {evento.get('filtro', '')} (proceso {evento.get('proceso', '?')})"
+                    )
+                elif tipo == "fin":
+                    self.progreso_avance.emit(100)
+                elif tipo == "error":
+                    error = evento.get("mensaje", "error desconocido")
+        return error
+
+    def enviar_a_servicio(self):
+        # Devuelve False si el servicio no está levantado (se cae a lanzar mpiexec)
+        if not self.trabajo or not os.path.exists(RUTA_SERVICIO):
+            return False
+        conexion = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        try:
+            conexion.connect(RUTA_SERVICIO)
+        except OSError:
+            conexion.close()
+            return False
+
+        pedido = "".join(f"{clave}={valor}\n" for clave, valor in self.trabajo.items()) + "\n"
+        conexion.sendall(pedido.encode("utf-8"))
+        self.progreso.emit(f"Trabajo enviado al servicio en {RUTA_SERVICIO}")
+        error = self.leer_eventos(conexion)
+
+        salida = f"\n⚠ El servicio informó un error: {error}\n" if error else ""
+        if os.path.exists(self.reporte_path):
+            with open(self.reporte_path, "r") as f:
+                salida += "\n📄 Reporte total:\n" + f.read()
+        self.terminado.emit(salida)
+        return True
 
     def run(self):
         try:
-            proceso = subprocess.Popen(self.comando, text=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+            if self.enviar_a_servicio():
+                return
+        except Exception as e:
+            self.error.emit(str(e))
+            return
+        if not self.comando:
+            # La vista previa solo tiene sentido con el servicio: lanzar mpiexec no es interactivo
+            self.terminado.emit("⚠ La vista previa necesita el servicio levantado (main --servicio).")
+            return
+
+        ruta_eventos = os.path.join(tempfile.gettempdir(), f"filtros_eventos_{os.getpid()}.sock")
+        servidor = None
+        hilo_eventos = None
+        try:
+            entorno = dict(os.environ)
+            for clave, valor in ENTORNO_CACHE.items():
+                entorno.setdefault(clave, valor)
+            try:
+                if os.path.exists(ruta_eventos):
+                    os.unlink(ruta_eventos)
+                servidor = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+                servidor.bind(ruta_eventos)
+                servidor.listen(1)
+                servidor.settimeout(0.5)
+                hilo_eventos = threading.Thread(target=self.escuchar_eventos, args=(servidor,), daemon=True)
+                hilo_eventos.start()
+                # mpiexec propaga el entorno a los procesos; solo el proceso 0 lo usa
+                entorno["FILTROS_EVENTOS"] = ruta_eventos
+            except OSError as e:
+                self.progreso.emit(f"⚠ Sin canal de eventos ({e}); el avance se estima por la salida.")
+
+            proceso = subprocess.Popen(self.comando, text=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE, env=entorno)
 
             procesadas = 0
             for linea in proceso.stdout:
                 linea = linea.strip()
                 self.progreso.emit(linea)
-                if "-> [" in linea:
+                # Sin canal de eventos se sigue estimando el avance por las líneas de salida
+                if not self.eventos_conectados and "-> [" in linea and self.total_esperado:
                     procesadas += 1
                     porcentaje = int((procesadas / self.total_esperado) * 100)
                     self.progreso_avance.emit(min(porcentaje, 100))
@@ -33,6 +175,10 @@ class Worker(QThread):
             stderr = proceso.stderr.read()
             returncode = proceso.wait()
 
+            self.fin_eventos = True
+            if hilo_eventos:
+                hilo_eventos.join(timeout=2)
+
             salida = ""
             if returncode != 0:
                 salida += f"\n⚠ El programa terminó con código {returncode}\n"
@@ -49,6 +195,12 @@ class Worker(QThread):
 
         except Exception as e:
             self.error.emit(str(e))
+        finally:
+            self.fin_eventos = True
+            if servidor:
+                servidor.close()
+                if os.path.exists(ruta_eventos):
+                    os.unlink(ruta_eventos)
 
 
 class CopiadorWorker(QThread):
@@ -104,6 +256,11 @@ class Interfaz(QtWidgets.QMainWindow):
         self.botonEntrada.clicked.connect(self.seleccionar_entrada)
         self.botonProcesar.clicked.connect(self.ejecutar_programa_c)
         self.horizontalSlider.valueChanged.connect(self.actualizar_valor_slider)
+        # Al soltar el slider se pide una vista previa reducida; la corrida completa
+        # queda para cuando se confirma con botonProcesar
+        self.horizontalSlider.sliderReleased.connect(self.pedir_vista_previa)
+        self.worker_preview = None
+        self.preview_pendiente = False
 
         # Configuración del slider
         self.horizontalSlider.setMinimum(3)
@@ -129,6 +286,40 @@ class Interfaz(QtWidgets.QMainWindow):
             self.horizontalSlider.setValue(valor)
         self.sliderLabel.setText(f"Kernel: {valor}")
 
+    def pedir_vista_previa(self):
+        if not self.rutaEntrada.text().strip() or not os.path.exists(RUTA_SERVICIO):
+            return
+        # Si ya hay una en curso se pide otra al terminar, con el valor que tenga el slider
+        if self.worker_preview and self.worker_preview.isRunning():
+            self.preview_pendiente = True
+            return
+
+        trabajo = {
+            "carpeta": os.path.abspath(self.img_dir),
+            "kernels": self.horizontalSlider.value(),
+            "filtros": "todos",
+            "preview": NIVEL_VISTA_PREVIA,
+        }
+        self.statusBar().showMessage(f"Vista previa con kernel {trabajo['kernels']}...")
+        self.worker_preview = Worker(None, "", self.total_esperado, trabajo)
+        self.worker_preview.rendimiento.connect(self.statusBar().showMessage)
+        self.worker_preview.terminado.connect(self.vista_previa_lista)
+        self.worker_preview.error.connect(self.mostrar_error)
+        self.worker_preview.start()
+
+    def vista_previa_lista(self, resumen):
+        if resumen.strip():
+            self.resultadosTexto.append(resumen)
+        kernel = self.worker_preview.trabajo["kernels"]
+        self.resultadosTexto.append(
+            f"🔍 Vista previa (1/{2 ** NIVEL_VISTA_PREVIA}) con kernel {kernel} escalado a "
+            f"{kernel_vista_previa(kernel)} para la imagen reducida, en {CARPETA_VISTA_PREVIA} "
+            f"(los archivos *_blur_{kernel}.bmp). Usa Procesar para la resolución completa."
+        )
+        if self.preview_pendiente:
+            self.preview_pendiente = False
+            self.pedir_vista_previa()
+
     def seleccionar_entrada(self):
         self.resultadosTexto.clear()
 
@@ -173,12 +364,15 @@ class Interfaz(QtWidgets.QMainWindow):
         wrapper_path = "/mirror/diff_images/procesador_wrapper.sh"
         reporte_path = "/mirror/diff_images/reporte_total.txt"
 
-        if not os.path.exists(wrapper_path) or not os.access(wrapper_path, os.X_OK):
-            self.resultadosTexto.append(f"❌ El script no está disponible o sin permisos: {wrapper_path}")
-            return
-        if not os.path.exists(self.machinefile_path):
-            self.resultadosTexto.append(f"❌ No se encontró el machinefile: {self.machinefile_path}")
-            return
+        # Con el servicio levantado no hace falta lanzar mpiexec
+        trabajo = {"carpeta": os.path.abspath(self.img_dir), "kernels": kernel_size, "filtros": "todos"}
+        if not os.path.exists(RUTA_SERVICIO):
+            if not os.path.exists(wrapper_path) or not os.access(wrapper_path, os.X_OK):
+                self.resultadosTexto.append(f"❌ El script no está disponible o sin permisos: {wrapper_path}")
+                return
+            if not os.path.exists(self.machinefile_path):
+                self.resultadosTexto.append(f"❌ No se encontró el machinefile: {self.machinefile_path}")
+                return
 
         comando = [
             "mpiexec",
@@ -189,9 +383,10 @@ class Interfaz(QtWidgets.QMainWindow):
         ]
 
         self.botonProcesar.setEnabled(False)
-        self.worker = Worker(comando, reporte_path, self.total_esperado)
+        self.worker = Worker(comando, reporte_path, self.total_esperado, trabajo)
         self.worker.progreso.connect(lambda linea: self.resultadosTexto.append(f"> {linea}"))
         self.worker.progreso_avance.connect(self.progressBar.setValue)
+        self.worker.rendimiento.connect(self.statusBar().showMessage)
         self.worker.terminado.connect(self.procesamiento_finalizado)
         self.worker.error.connect(self.mostrar_error)
         self.worker.start()
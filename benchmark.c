@@ -0,0 +1,477 @@
+// benchmark.c
+// Microbenchmarks de los filtros de filtros_img.h (incluida la pasada fusionada de grises
+// y espejos) sobre imágenes sintéticas.
+//
+//   gcc -O2 -fopenmp benchmark.c -o benchmark
+//   ./benchmark -o actual.csv                 # mide y guarda resultados
+//   ./benchmark -o nuevo.csv -b actual.csv    # compara contra una línea base
+//   ./benchmark -g img_sinteticas             # solo genera BMPs de prueba
+//   ./benchmark -c                            # comprueba resultados; código 1 si falla
+//
+// Los resultados son CSV (filtro,ancho,alto,kernel,segundos,mpix_s) con el mejor
+// tiempo de varias repeticiones. Con -b se marca como regresión todo filtro cuyo
+// throughput baje más que la tolerancia (-t, 10% por defecto) y se sale con código 1.
+//
+// Además de los filtros se miden las otras dos rutas del blur: blur_streaming (forzado,
+// aunque la imagen no llegue al umbral) y blur_multi, todos los kernels de kernels_bench
+// en una pasada (aparece con kernel 0).
+//
+// -c compara byte a byte cada variante de grises (escalar, SSE2, AVX2 y sus versiones de
+// 8 bits) contra la fórmula original en double sobre los 2^24 colores posibles, y las
+// tres rutas del blur (franjas, streaming y multi) contra el blur original de dos pasadas.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include "filtros_img.h"
+
+#define MAX_RESULTADOS 256
+
+typedef struct {
+    char filtro[48];
+    int ancho;
+    int alto;
+    int kernel;
+    double segundos;
+    double mpix_s;
+} ResultadoBench;
+
+// Tamaños con anchos impares para ejercitar el padding de fila
+int tamanos_bench[][2] = { { 641, 481 }, { 1921, 1081 }, { 3841, 2161 } };
+int kernels_bench[] = { 55, 105, 155 };
+
+// Variantes de blur que se miden aparte de los filtros de filtros_img.h
+enum { BENCH_BLUR_STREAMING = N_FILTROS, BENCH_BLUR_MULTI, N_BENCH };
+const char* nombres_bench_blur[] = { "blur_streaming", "blur_multi" };
+
+#define N_KERNELS_BENCH ((int)(sizeof(kernels_bench) / sizeof(kernels_bench[0])))
+#define N_EXTRA (N_KERNELS_BENCH > 3 ? N_KERNELS_BENCH : 3)
+
+// Pixeles deterministas (LCG) para que cada corrida mida exactamente los mismos datos
+void llenar_sintetico(unsigned char* data, int ancho, int alto, int row_padded, unsigned int semilla) {
+    unsigned int x = semilla * 2654435761u + 1;
+    for (int y = 0; y < alto; y++) {
+        unsigned char* row = data + (size_t)y * row_padded;
+        for (int i = 0; i < ancho * 3; i++) {
+            x = x * 1664525u + 1013904223u;
+            row[i] = (unsigned char)(x >> 24);
+        }
+        memset(row + ancho * 3, 0, row_padded - ancho * 3);
+    }
+}
+
+int generar_bmp_sintetico(const char* ruta, int ancho, int alto, unsigned int semilla) {
+    int row_padded = (ancho * 3 + 3) & (~3);
+    size_t tam = (size_t)row_padded * alto;
+    unsigned char header[54] = { 'B', 'M' };
+
+    *(int*)&header[2] = (int)(54 + tam);
+    *(int*)&header[10] = 54;
+    *(int*)&header[14] = 40;
+    *(int*)&header[18] = ancho;
+    *(int*)&header[22] = alto;
+    *(short*)&header[26] = 1;
+    *(short*)&header[28] = 24;
+    *(int*)&header[34] = (int)tam;
+
+    unsigned char* data = (unsigned char*) malloc(tam);
+    llenar_sintetico(data, ancho, alto, row_padded, semilla);
+
+    FILE* f = fopen(ruta, "wb");
+    if (!f) {
+        fprintf(stderr, "Error al abrir archivo: %s\n", ruta);
+        free(data);
+        return -1;
+    }
+    fwrite(header, 1, 54, f);
+    fwrite(data, 1, tam, f);
+    fclose(f);
+    free(data);
+    return 0;
+}
+
+// blur_buffer por la ruta de streaming aunque la imagen no llegue a BLUR_STREAMING_MIN_BYTES
+int blur_buffer_streaming(const unsigned char* src, unsigned char* dst, int ancho, int alto, int row_padded,
+                          int kernel) {
+    int k = kernel / 2;
+    int max_count = 2 * k + 1;
+    int max_dim = ancho > alto ? ancho : alto;
+    if (max_count > max_dim) max_count = max_dim;
+    if (max_count > BLUR_MAX_COUNT) return -1;
+
+    unsigned long long* inv = blur_reciprocos(max_count);
+    blur_streaming(src, dst, ancho, alto, row_padded, k, inv);
+    pool_devolver(inv);
+    return 0;
+}
+
+// extra son tres buffers más para las salidas de la pasada fusionada de grises y espejos
+// y las de blur_multi (uno por kernel de kernels_bench)
+double medir(int filtro, int kernel, const unsigned char* src, unsigned char* gris, unsigned char* dst,
+             unsigned char** extra, int ancho, int alto, int row_padded, int repeticiones) {
+    double mejor = -1;
+
+    for (int r = 0; r < repeticiones; r++) {
+        double t0 = omp_get_wtime();
+        switch (filtro) {
+        case FILTRO_GRISES:
+            grises_buffer(src, dst, ancho, alto, row_padded);
+            break;
+        case FILTRO_ESPEJO_H_COLOR:
+            espejo_horizontal_buffer(src, dst, ancho, alto, row_padded);
+            break;
+        case FILTRO_ESPEJO_V_COLOR:
+            espejo_vertical_buffer(src, dst, alto, row_padded);
+            break;
+        case FILTRO_ESPEJO_H_GRIS:
+            grises_buffer(src, gris, ancho, alto, row_padded);
+            espejo_horizontal_buffer(gris, dst, ancho, alto, row_padded);
+            break;
+        case FILTRO_ESPEJO_V_GRIS:
+            grises_buffer(src, gris, ancho, alto, row_padded);
+            espejo_vertical_buffer(gris, dst, alto, row_padded);
+            break;
+        case FILTRO_BLUR:
+            blur_buffer(src, dst, ancho, alto, row_padded, kernel);
+            break;
+        case FILTRO_GRISES_ESPEJOS:
+            grises_espejos_buffer(src, gris, dst, extra[0], extra[1], extra[2], ancho, alto, row_padded,
+                                  salida_gris_8bits());
+            break;
+        case BENCH_BLUR_STREAMING:
+            blur_buffer_streaming(src, dst, ancho, alto, row_padded, kernel);
+            break;
+        case BENCH_BLUR_MULTI:
+            blur_multi_buffer(src, extra, ancho, alto, row_padded, kernels_bench, N_KERNELS_BENCH);
+            break;
+        }
+        double t = omp_get_wtime() - t0;
+        if (mejor < 0 || t < mejor) mejor = t;
+    }
+    return mejor;
+}
+
+// 0.21*r + 0.72*g + 0.07*b como lo calculaba el filtro original: cada operación en
+// double, sin FMA, truncado a byte
+unsigned char gris_referencia(unsigned char b, unsigned char g, unsigned char r) {
+    volatile double pr = 0.21 * r, pg = 0.72 * g, pb = 0.07 * b;
+    volatile double suma = pr + pg;
+    suma = suma + pb;
+    return (unsigned char) suma;
+}
+
+typedef struct {
+    const char* nombre;
+    grises_fila_fn fn;
+    int bytes;                  // bytes de salida por pixel
+} VarianteGris;
+
+// Recorre todos los colores en filas de 4093 pixeles (impar, para que cada variante
+// pase también por su cola escalar). Devuelve la cantidad de pixeles distintos.
+int comprobar_grises() {
+    VarianteGris variantes[6];
+    int n = 0;
+    variantes[n++] = (VarianteGris){ "escalar", grises_fila_escalar, 3 };
+    variantes[n++] = (VarianteGris){ "escalar_8bits", grises8_fila_escalar, 1 };
+#ifdef GRISES_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        variantes[n++] = (VarianteGris){ "sse2", grises_fila_sse2, 3 };
+        variantes[n++] = (VarianteGris){ "sse2_8bits", grises8_fila_sse2, 1 };
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        variantes[n++] = (VarianteGris){ "avx2", grises_fila_avx2, 3 };
+        variantes[n++] = (VarianteGris){ "avx2_8bits", grises8_fila_avx2, 1 };
+    }
+#endif
+
+    const int ancho = 4093;
+    const int total = 1 << 24;
+    unsigned char* src = (unsigned char*) malloc((size_t)ancho * 3);
+    unsigned char* esperado = (unsigned char*) malloc(ancho);
+    unsigned char* dst = (unsigned char*) malloc((size_t)ancho * 3);
+    int fallas_total = 0;
+
+    for (int v = 0; v < n; v++) {
+        int fallas = 0;
+        for (int inicio = 0; inicio < total; inicio += ancho) {
+            int largo = total - inicio < ancho ? total - inicio : ancho;
+            for (int x = 0; x < largo; x++) {
+                int c = inicio + x;
+                src[x * 3] = c & 0xFF;
+                src[x * 3 + 1] = (c >> 8) & 0xFF;
+                src[x * 3 + 2] = c >> 16;
+                esperado[x] = gris_referencia(src[x * 3], src[x * 3 + 1], src[x * 3 + 2]);
+            }
+            variantes[v].fn(src, dst, largo);
+            for (int x = 0; x < largo; x++) {
+                const unsigned char* o = dst + x * variantes[v].bytes;
+                int ok = o[0] == esperado[x] && (variantes[v].bytes == 1 || (o[1] == esperado[x] && o[2] == esperado[x]));
+                if (!ok && fallas++ < 5) {
+                    fprintf(stderr, "grises %s: bgr=(%d,%d,%d) da %d, se esperaba %d\n", variantes[v].nombre,
+                            src[x * 3], src[x * 3 + 1], src[x * 3 + 2], o[0], esperado[x]);
+                }
+            }
+        }
+        printf("%s grises %-14s %d pixeles distintos\n", fallas ? "FALLA" : "ok   ", variantes[v].nombre, fallas);
+        fallas_total += fallas;
+    }
+
+    free(src);
+    free(esperado);
+    free(dst);
+    return fallas_total;
+}
+
+// Blur original (apply_blur antes de las optimizaciones): pasada horizontal y vertical,
+// cada pixel es la suma de su ventana dividida entre los pixeles dentro de la imagen
+void blur_referencia(const unsigned char* src, unsigned char* dst, int ancho, int alto, int row_padded,
+                     int kernel) {
+    int k = kernel / 2;
+    int n = ancho * 3;
+    unsigned char* temp = (unsigned char*) malloc((size_t)row_padded * alto);
+
+    for (int y = 0; y < alto; y++) {
+        const unsigned char* fila = src + (size_t)y * row_padded;
+        unsigned char* out = temp + (size_t)y * row_padded;
+        for (int x = 0; x < ancho; x++) {
+            for (int c = 0; c < 3; c++) {
+                int suma = 0, cuenta = 0;
+                for (int nx = x - k; nx <= x + k; nx++) {
+                    if (nx < 0 || nx >= ancho) continue;
+                    suma += fila[nx * 3 + c];
+                    cuenta++;
+                }
+                out[x * 3 + c] = suma / cuenta;
+            }
+        }
+        memcpy(out + n, fila + n, row_padded - n);
+    }
+
+    for (int y = 0; y < alto; y++) {
+        unsigned char* out = dst + (size_t)y * row_padded;
+        for (int i = 0; i < n; i++) {
+            int suma = 0, cuenta = 0;
+            for (int ny = y - k; ny <= y + k; ny++) {
+                if (ny < 0 || ny >= alto) continue;
+                suma += temp[(size_t)ny * row_padded + i];
+                cuenta++;
+            }
+            out[i] = suma / cuenta;
+        }
+        memcpy(out + n, temp + (size_t)y * row_padded + n, row_padded - n);
+    }
+    free(temp);
+}
+
+int comparar_buffers(const char* ruta_blur, const unsigned char* esperado, const unsigned char* obtenido,
+                     size_t tam, int ancho, int alto, int kernel) {
+    for (size_t i = 0; i < tam; i++) {
+        if (esperado[i] == obtenido[i]) continue;
+        fprintf(stderr, "%s %dx%d k=%d: byte %zu da %d, se esperaba %d\n", ruta_blur, ancho, alto, kernel, i,
+                obtenido[i], esperado[i]);
+        return 1;
+    }
+    return 0;
+}
+
+// Tamaños chicos (incluidos kernels más grandes que la imagen y kernels pares) y uno que
+// pasa PARALELO_MIN_PIXELES para que las rutas paralelas repartan bandas entre hilos.
+// Devuelve la cantidad de combinaciones con diferencias.
+int comprobar_blur() {
+    int tamanos[][2] = { { 1, 1 }, { 7, 3 }, { 97, 61 }, { 641, 481 } };
+    int kernels[] = { 1, 4, 55, 155, 1001 };
+    int n_tamanos = sizeof(tamanos) / sizeof(tamanos[0]);
+    int n_kernels = sizeof(kernels) / sizeof(kernels[0]);
+    int fallas[3] = { 0, 0, 0 };
+    const char* rutas[3] = { "franjas", "streaming", "multi" };
+
+    for (int t = 0; t < n_tamanos; t++) {
+        int ancho = tamanos[t][0], alto = tamanos[t][1];
+        int row_padded = (ancho * 3 + 3) & (~3);
+        size_t tam = (size_t)row_padded * alto;
+        unsigned char* src = (unsigned char*) malloc(tam);
+        unsigned char* esperado = (unsigned char*) malloc(tam * n_kernels);
+        unsigned char* obtenido = (unsigned char*) malloc(tam * n_kernels);
+        unsigned char* dst[16];
+
+        // Padding distinto de cero para comprobar que se copia de la entrada
+        llenar_sintetico(src, ancho, alto, row_padded, t + 7);
+        for (int y = 0; y < alto; y++) memset(src + (size_t)y * row_padded + ancho * 3, 0x5A, row_padded - ancho * 3);
+
+        for (int i = 0; i < n_kernels; i++) {
+            blur_referencia(src, esperado + tam * i, ancho, alto, row_padded, kernels[i]);
+            dst[i] = obtenido + tam * i;
+        }
+
+        for (int i = 0; i < n_kernels; i++) {
+            memset(dst[i], 0xA5, tam);
+            blur_buffer(src, dst[i], ancho, alto, row_padded, kernels[i]);
+            fallas[0] += comparar_buffers(rutas[0], esperado + tam * i, dst[i], tam, ancho, alto, kernels[i]);
+
+            memset(dst[i], 0xA5, tam);
+            blur_buffer_streaming(src, dst[i], ancho, alto, row_padded, kernels[i]);
+            fallas[1] += comparar_buffers(rutas[1], esperado + tam * i, dst[i], tam, ancho, alto, kernels[i]);
+        }
+
+        memset(obtenido, 0xA5, tam * n_kernels);
+        blur_multi_buffer(src, dst, ancho, alto, row_padded, kernels, n_kernels);
+        for (int i = 0; i < n_kernels; i++)
+            fallas[2] += comparar_buffers(rutas[2], esperado + tam * i, dst[i], tam, ancho, alto, kernels[i]);
+
+        free(src);
+        free(esperado);
+        free(obtenido);
+    }
+
+    for (int r = 0; r < 3; r++)
+        printf("%s blur %-14s %d combinaciones distintas\n", fallas[r] ? "FALLA" : "ok   ", rutas[r], fallas[r]);
+    return fallas[0] + fallas[1] + fallas[2];
+}
+
+int leer_resultados(const char* ruta, ResultadoBench* res) {
+    FILE* f = fopen(ruta, "r");
+    if (!f) {
+        fprintf(stderr, "No se pudo abrir la línea base: %s\n", ruta);
+        return -1;
+    }
+
+    char linea[256];
+    int n = 0;
+    while (fgets(linea, sizeof(linea), f) && n < MAX_RESULTADOS) {
+        ResultadoBench* r = &res[n];
+        if (sscanf(linea, "%47[^,],%d,%d,%d,%lf,%lf", r->filtro, &r->ancho, &r->alto, &r->kernel,
+                   &r->segundos, &r->mpix_s) == 6)
+            n++;
+    }
+    fclose(f);
+    return n;
+}
+
+int main(int argc, char** argv) {
+    const char* salida = NULL;
+    const char* base = NULL;
+    const char* dir_generar = NULL;
+    double tolerancia = 0.10;
+    int repeticiones = 3;
+    int comprobar = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:b:t:r:g:c")) != -1) {
+        switch (opt) {
+        case 'o': salida = optarg; break;
+        case 'b': base = optarg; break;
+        case 't': tolerancia = atof(optarg); break;
+        case 'r': repeticiones = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+        case 'g': dir_generar = optarg; break;
+        case 'c': comprobar = 1; break;
+        default:
+            fprintf(stderr, "Uso: %s [-o resultados.csv] [-b base.csv] [-t tolerancia] [-r repeticiones] [-g dir] [-c]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    int n_tamanos = sizeof(tamanos_bench) / sizeof(tamanos_bench[0]);
+    int n_kernels = N_KERNELS_BENCH;
+
+    if (dir_generar) {
+        mkdir(dir_generar, 0755);
+        for (int i = 0; i < n_tamanos; i++) {
+            char ruta[512];
+            snprintf(ruta, sizeof(ruta), "%s/sintetica_%dx%d.bmp", dir_generar, tamanos_bench[i][0], tamanos_bench[i][1]);
+            if (generar_bmp_sintetico(ruta, tamanos_bench[i][0], tamanos_bench[i][1], i + 1) == 0)
+                printf("Generada: %s\n", ruta);
+        }
+        return 0;
+    }
+
+    if (comprobar) {
+        // Varios hilos aunque haya un solo núcleo, para que el blur reparta bandas
+        if (omp_get_max_threads() < 4) omp_set_num_threads(4);
+        int fallas = comprobar_grises();
+        fallas += comprobar_blur();
+        return fallas > 0 ? 1 : 0;
+    }
+
+    printf("Benchmark de filtros: %d hilos OpenMP, grises %s, %d repeticiones\n",
+           omp_get_max_threads(), grises_nombre(grises_seleccionar()), repeticiones);
+
+    ResultadoBench resultados[MAX_RESULTADOS];
+    int n = 0;
+
+    for (int i = 0; i < n_tamanos; i++) {
+        int ancho = tamanos_bench[i][0], alto = tamanos_bench[i][1];
+        int row_padded = (ancho * 3 + 3) & (~3);
+        size_t tam = (size_t)row_padded * alto;
+        unsigned char* src = (unsigned char*) malloc(tam);
+        unsigned char* gris = (unsigned char*) malloc(tam);
+        unsigned char* dst = (unsigned char*) malloc(tam);
+        unsigned char* extra[N_EXTRA];
+        for (int e = 0; e < N_EXTRA; e++) extra[e] = (unsigned char*) malloc(tam);
+        llenar_sintetico(src, ancho, alto, row_padded, i + 1);
+
+        for (int f = 0; f < N_BENCH; f++) {
+            int por_kernel = f == FILTRO_BLUR || f == BENCH_BLUR_STREAMING;
+            int variantes = por_kernel ? n_kernels : 1;
+            for (int v = 0; v < variantes; v++) {
+                ResultadoBench* r = &resultados[n++];
+                r->kernel = por_kernel ? kernels_bench[v] : 0;
+                r->ancho = ancho;
+                r->alto = alto;
+                snprintf(r->filtro, sizeof(r->filtro), "%s", f < N_FILTROS ? nombres_filtros[f] : nombres_bench_blur[f - N_FILTROS]);
+                r->segundos = medir(f, r->kernel, src, gris, dst, extra, ancho, alto, row_padded, repeticiones);
+                r->mpix_s = (double)ancho * alto / 1e6 / (r->segundos > 0 ? r->segundos : 1e-9);
+                printf("%-26s %5dx%-5d k=%-3d %10.6f s %10.2f Mpix/s\n",
+                       r->filtro, ancho, alto, r->kernel, r->segundos, r->mpix_s);
+            }
+        }
+
+        free(src);
+        free(gris);
+        free(dst);
+        for (int e = 0; e < N_EXTRA; e++) free(extra[e]);
+    }
+
+    if (salida) {
+        FILE* f = fopen(salida, "w");
+        if (!f) {
+            fprintf(stderr, "Error al abrir archivo: %s\n", salida);
+            return 2;
+        }
+        fprintf(f, "filtro,ancho,alto,kernel,segundos,mpix_s\n");
+        for (int i = 0; i < n; i++) {
+            fprintf(f, "%s,%d,%d,%d,%.9f,%.4f\n", resultados[i].filtro, resultados[i].ancho, resultados[i].alto,
+                    resultados[i].kernel, resultados[i].segundos, resultados[i].mpix_s);
+        }
+        fclose(f);
+    }
+
+    if (!base) return 0;
+
+    ResultadoBench referencia[MAX_RESULTADOS];
+    int n_ref = leer_resultados(base, referencia);
+    if (n_ref < 0) return 2;
+
+    int regresiones = 0;
+    printf("\nComparación contra %s (tolerancia %.0f%%):\n", base, tolerancia * 100);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n_ref; j++) {
+            const ResultadoBench* a = &resultados[i];
+            const ResultadoBench* b = &referencia[j];
+            if (strcmp(a->filtro, b->filtro) != 0 || a->ancho != b->ancho || a->alto != b->alto || a->kernel != b->kernel)
+                continue;
+
+            double cambio = b->mpix_s > 0 ? a->mpix_s / b->mpix_s - 1.0 : 0.0;
+            int regresion = cambio < -tolerancia;
+            regresiones += regresion;
+            printf("%s %-26s %5dx%-5d k=%-3d %+7.1f%%\n", regresion ? "REGRESION" : "ok       ",
+                   a->filtro, a->ancho, a->alto, a->kernel, cambio * 100);
+        }
+    }
+
+    printf("%d regresiones\n", regresiones);
+    return regresiones > 0 ? 1 : 0;
+}
@@ -0,0 +1,210 @@
+// blur_mpi.h
+#ifndef BLUR_MPI_H
+#define BLUR_MPI_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <omp.h>
+#include <mpi.h>
+#include "filtros_img.h"
+
+// Blur de una sola imagen repartido entre procesos MPI, para lotes con menos imágenes
+// que procesos. La imagen se corta en franjas horizontales, una por proceso; cada uno
+// hace la pasada horizontal de sus filas, intercambia k = kernel/2 filas de borde (halo)
+// con sus vecinos y hace la pasada vertical de su franja. La salida se escribe en
+// paralelo con MPI-IO, cada proceso en su rango de filas del archivo.
+//
+// Dentro de cada nodo la imagen se lee una sola vez: el primer proceso del nodo la
+// copia a una ventana de memoria compartida MPI y los demás leen de ahí.
+
+typedef struct {
+    ImagenBMP img;
+    MPI_Win ventana;
+    MPI_Comm nodo;
+} ImagenCompartida;
+
+// Colectiva sobre `comm`. Devuelve 0 si todos los procesos tienen la imagen.
+int imagen_compartida_cargar(const char* ruta, MPI_Comm comm, ImagenCompartida* ic) {
+    int rank_nodo, ok = 1;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &ic->nodo);
+    MPI_Comm_rank(ic->nodo, &rank_nodo);
+
+    ImagenBMP archivo;
+    MPI_Aint tam = 0;
+    if (rank_nodo == 0) {
+        if (cargar_bmp(ruta, &archivo) == 0) tam = (MPI_Aint) archivo.tam_mapa;
+        else ok = 0;
+    }
+
+    unsigned char* base;
+    MPI_Win_allocate_shared(tam, 1, MPI_INFO_NULL, ic->nodo, &base, &ic->ventana);
+    if (rank_nodo == 0 && ok) {
+        memcpy(base, archivo.header, archivo.tam_mapa);
+        liberar_bmp(&archivo);
+    }
+    MPI_Barrier(ic->nodo);
+
+    int disp;
+    MPI_Win_shared_query(ic->ventana, 0, &tam, &disp, &base);
+    MPI_Bcast(&ok, 1, MPI_INT, 0, ic->nodo);
+
+    // Cada proceso valida el encabezado compartido con el mismo parser de siempre
+    memset(&ic->img, 0, sizeof(ImagenBMP));
+    if (ok && parsear_encabezado_bmp(base, tam, ruta, &ic->img) == 0) {
+        ic->img.header = base;
+        ic->img.data = base + ic->img.offset_pixels;
+        ic->img.tam_mapa = tam;
+    } else {
+        ok = 0;
+    }
+
+    int todos;
+    MPI_Allreduce(&ok, &todos, 1, MPI_INT, MPI_MIN, comm);
+    return todos ? 0 : -1;
+}
+
+void imagen_compartida_liberar(ImagenCompartida* ic) {
+    MPI_Win_free(&ic->ventana);
+    MPI_Comm_free(&ic->nodo);
+    memset(&ic->img, 0, sizeof(ImagenBMP));
+}
+
+// Procesos que conviene usar: cada franja debe tener al menos una ventana (2k+1 filas)
+// para que el halo venga solo de los vecinos inmediatos.
+int blur_mpi_procesos(int alto, int kernel_size, int size) {
+    int p = alto / (2 * (kernel_size / 2) + 1);
+    if (p > size) p = size;
+    return p < 1 ? 1 : p;
+}
+
+// Colectiva sobre `comm`: escribe en `out` el blur de img con el mismo resultado que
+// blur_buffer. Cada proceso registra en los contadores el cómputo de su franja y el
+// proceso 0 escribe el log. Devuelve 0 si todos los procesos terminaron bien.
+int blur_franjas_mpi(const ImagenBMP* img, const char* out, const char* nombre_base, int kernel_size, MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    int width = img->ancho, height = img->alto, row_padded = img->row_padded;
+    int k = kernel_size / 2;
+    int max_count = 2 * k + 1;
+    int max_dim = width > height ? width : height;
+    if (max_count > max_dim) max_count = max_dim;
+    if (max_count > BLUR_MAX_COUNT) {
+        if (rank == 0) fprintf(stderr, "[ERROR] Kernel de blur demasiado grande: %d\n", kernel_size);
+        return -1;
+    }
+
+    // Solo participan los primeros p procesos; el resto queda fuera del comunicador
+    int p = blur_mpi_procesos(height, kernel_size, size);
+    MPI_Comm franjas;
+    MPI_Comm_split(comm, rank < p ? 0 : MPI_UNDEFINED, rank, &franjas);
+
+    // El archivo puede ser un enlace duro a la caché: se crea uno nuevo
+    if (rank == 0) unlink(out);
+    MPI_Barrier(comm);
+    if (franjas == MPI_COMM_NULL) {
+        int ok = 1, todos;
+        MPI_Allreduce(&ok, &todos, 1, MPI_INT, MPI_MIN, comm);
+        return todos ? 0 : -1;
+    }
+
+    int y0 = (int)((long long)height * rank / p);
+    int y1 = (int)((long long)height * (rank + 1) / p);
+    int ya = rank > 0 ? y0 - k : y0;                 // filas locales [ya, yb) con los halos
+    int yb = rank < p - 1 ? y1 + k : y1;
+    int n = width * 3;
+    int paralelo = paralelo_interno(width, y1 - y0);
+
+    MedicionHW m;
+    medicion_iniciar(&m, FILTRO_BLUR, paralelo);
+    unsigned long long* inv = blur_reciprocos(max_count);
+    unsigned char* temp = (unsigned char*) pool_tomar((size_t)(yb - ya) * row_padded);
+    unsigned char* salida = (unsigned char*) pool_tomar((size_t)(yb - ya) * row_padded);
+
+    // Pasada horizontal de las filas propias
+    #pragma omp parallel for schedule(static) if(paralelo)
+    for (int y = y0; y < y1; y++) {
+        const unsigned char* row = img->data + (size_t)y * row_padded;
+        unsigned char* fila = temp + (size_t)(y - ya) * row_padded;
+        blur_fila_horizontal(row, fila, width, k, inv);
+        memcpy(fila + n, row + n, row_padded - n);
+    }
+
+    // Halos: las primeras k filas propias van al vecino de arriba y las últimas al de abajo
+    MPI_Datatype tipo_fila;
+    MPI_Type_contiguous(row_padded, MPI_BYTE, &tipo_fila);
+    MPI_Type_commit(&tipo_fila);
+    int arriba = rank > 0 ? rank - 1 : MPI_PROC_NULL;
+    int abajo = rank < p - 1 ? rank + 1 : MPI_PROC_NULL;
+    unsigned char* propias = temp + (size_t)(y0 - ya) * row_padded;
+    MPI_Sendrecv(propias, rank > 0 ? k : 0, tipo_fila, arriba, 0,
+                 temp + (size_t)(y1 - ya) * row_padded, rank < p - 1 ? k : 0, tipo_fila, abajo, 0,
+                 franjas, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(propias + (size_t)(y1 - y0 - k) * row_padded, rank < p - 1 ? k : 0, tipo_fila, abajo, 1,
+                 temp, rank > 0 ? k : 0, tipo_fila, arriba, 1, franjas, MPI_STATUS_IGNORE);
+    MPI_Type_free(&tipo_fila);
+
+    // Pasada vertical en coordenadas locales: con halos completos las ventanas solo se
+    // recortan en los bordes reales de la imagen, igual que en blur_buffer
+    int filas = yb - ya, f0 = y0 - ya, f1 = y1 - ya;
+    int franjas_col = (n + BLUR_FRANJA - 1) / BLUR_FRANJA;
+    int bandas = 1;
+    if (paralelo) {
+        bandas = (2 * omp_get_max_threads() + franjas_col - 1) / franjas_col;
+        int max_bandas = (f1 - f0) / (4 * (2 * k + 1));
+        if (bandas > max_bandas) bandas = max_bandas;
+        if (bandas < 1) bandas = 1;
+    }
+
+    #pragma omp parallel for collapse(2) schedule(dynamic) if(paralelo)
+    for (int f = 0; f < franjas_col; f++) {
+        for (int b = 0; b < bandas; b++) {
+            unsigned int acc[BLUR_FRANJA];
+            int x0 = f * BLUR_FRANJA;
+            int ancho_franja = n - x0 < BLUR_FRANJA ? n - x0 : BLUR_FRANJA;
+            int b0 = f0 + (int)((long long)(f1 - f0) * b / bandas);
+            int b1 = f0 + (int)((long long)(f1 - f0) * (b + 1) / bandas);
+            blur_franja_vertical(temp + x0, salida + x0, ancho_franja, filas, row_padded, b0, b1, k, inv, acc);
+        }
+    }
+    for (int y = f0; y < f1; y++) {
+        memcpy(salida + (size_t)y * row_padded + n, temp + (size_t)y * row_padded + n, row_padded - n);
+    }
+
+    medicion_terminar(&m);
+    long long bytes = (long long)(y1 - y0) * row_padded;
+    medicion_registrar(&m, bytes, bytes);
+    if (rank == 0) generar_log(nombre_base, "blur", img->offset_pixels + img->tam, img->offset_pixels + img->tam, &m);
+
+    // Escritura paralela: el proceso 0 escribe además el encabezado
+    int ok = 1;
+    MPI_File fh;
+    if (MPI_File_open(franjas, out, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        if (rank == 0) fprintf(stderr, "Error al abrir archivo: %s\n", out);
+        ok = 0;
+    } else {
+        MPI_Datatype tipo_franja;
+        MPI_Type_contiguous(row_padded, MPI_BYTE, &tipo_franja);
+        MPI_Type_commit(&tipo_franja);
+        if (rank == 0) MPI_File_write_at(fh, 0, img->header, img->offset_pixels, MPI_BYTE, MPI_STATUS_IGNORE);
+        MPI_Offset pos = (MPI_Offset)img->offset_pixels + (MPI_Offset)y0 * row_padded;
+        if (MPI_File_write_at_all(fh, pos, salida + (size_t)f0 * row_padded, y1 - y0, tipo_franja, MPI_STATUS_IGNORE) != MPI_SUCCESS) ok = 0;
+        MPI_Type_free(&tipo_franja);
+        MPI_File_sync(fh);
+        MPI_File_close(&fh);
+    }
+
+    pool_devolver(salida);
+    pool_devolver(temp);
+    pool_devolver(inv);
+    MPI_Comm_free(&franjas);
+
+    int todos;
+    MPI_Allreduce(&ok, &todos, 1, MPI_INT, MPI_MIN, comm);
+    return todos ? 0 : -1;
+}
+
+#endif
@@ -0,0 +1,267 @@
+// bmp_io.h
+#ifndef BMP_IO_H
+#define BMP_IO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "pool_buffers.h"
+
+// E/S de BMP sin copias: la entrada se mapea de solo lectura y cada salida se crea
+// con su tamaño final y se mapea para que los filtros escriban los pixeles en su lugar.
+// Todos los filtros validan el encabezado con el mismo parser. Las salidas en grises
+// pueden escribirse además como BMP de 8 bits con paleta (crear_salida_bmp_gris8).
+
+// Imagen BMP de entrada. header apunta al inicio del archivo mapeado (todo lo que hay
+// antes de offset_pixels se copia tal cual a cada salida) y data a los pixeles.
+typedef struct {
+    const unsigned char* header;
+    int offset_pixels;
+    int ancho;
+    int alto;              // siempre positivo; top_down indica alto negativo en el archivo
+    int top_down;
+    int row_padded;
+    size_t tam;
+    const unsigned char* data;
+    size_t tam_mapa;
+} ImagenBMP;
+
+// Salida BMP con el encabezado ya escrito; los pixeles se escriben en data.
+// Sin ruta es solo un buffer en memoria del pool del hilo (p. ej. grises que no se guarda).
+// Con salidas_en_memoria (contenedor de salidas, contenedor.h) no se crea el archivo: el
+// mapa es memoria anónima y `nombre` guarda el nombre con que se agrega al contenedor.
+typedef struct {
+    int fd;
+    unsigned char* mapa;
+    size_t tam_mapa;
+    unsigned char* data;
+    char* nombre;
+} SalidaBMP;
+
+int salidas_en_memoria = 0;
+
+int parsear_encabezado_bmp(const unsigned char* buf, size_t tam_archivo, const char* ruta, ImagenBMP* img) {
+    if (tam_archivo < 54 || buf[0] != 'B' || buf[1] != 'M') {
+        fprintf(stderr, "[ERROR] Encabezado BMP inválido: %s\n", ruta);
+        return -1;
+    }
+
+    // Campos sin signo en el archivo: leídos como int, un tamaño cerca de INT_MAX
+    // desbordaba 14 + dib_header_size y pasaba la validación
+    uint32_t offset_pixels = *(const uint32_t*)&buf[10];
+    uint32_t dib_header_size = *(const uint32_t*)&buf[14];
+    int ancho = *(int*)&buf[18];
+    int alto = *(int*)&buf[22];
+    short bpp = *(short*)&buf[28];
+    int compression = *(int*)&buf[30];
+
+    if (bpp != 24 || compression != 0) {
+        fprintf(stderr, "[ERROR] Solo se soportan BMPs de 24 bits sin compresión. bpp=%d, compression=%d\n", bpp, compression);
+        return -1;
+    }
+    if (dib_header_size < 40 || (size_t)offset_pixels < 14 + (size_t)dib_header_size ||
+        (size_t)offset_pixels > tam_archivo || offset_pixels > INT_MAX) {
+        fprintf(stderr, "[ERROR] Offset de pixeles inválido en %s: %u\n", ruta, offset_pixels);
+        return -1;
+    }
+    if (ancho <= 0 || alto == 0 || ancho > (1 << 24) || alto > (1 << 24) || alto < -(1 << 24)) {
+        fprintf(stderr, "[ERROR] Dimensiones inválidas en %s: %dx%d\n", ruta, ancho, alto);
+        return -1;
+    }
+
+    img->offset_pixels = (int)offset_pixels;
+    img->ancho = ancho;
+    img->top_down = alto < 0;
+    img->alto = alto < 0 ? -alto : alto;
+    img->row_padded = (ancho * 3 + 3) & (~3);
+    img->tam = (size_t)img->row_padded * img->alto;
+
+    if ((size_t)offset_pixels + img->tam > tam_archivo) {
+        fprintf(stderr, "[ERROR] Archivo BMP truncado: %s\n", ruta);
+        return -1;
+    }
+    return 0;
+}
+
+int cargar_bmp(const char* ruta, ImagenBMP* img) {
+    memset(img, 0, sizeof(ImagenBMP));
+
+    int fd = open(ruta, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error al abrir archivo: %s\n", ruta);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 54) {
+        fprintf(stderr, "[ERROR] Encabezado BMP inválido: %s\n", ruta);
+        close(fd);
+        return -1;
+    }
+
+    void* mapa = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapa == MAP_FAILED) {
+        fprintf(stderr, "[ERROR] No se pudo mapear %s\n", ruta);
+        return -1;
+    }
+
+    if (parsear_encabezado_bmp((const unsigned char*) mapa, st.st_size, ruta, img) != 0) {
+        munmap(mapa, st.st_size);
+        memset(img, 0, sizeof(ImagenBMP));
+        return -1;
+    }
+
+    madvise(mapa, st.st_size, MADV_SEQUENTIAL);
+    img->header = (const unsigned char*) mapa;
+    img->data = img->header + img->offset_pixels;
+    img->tam_mapa = st.st_size;
+    return 0;
+}
+
+void liberar_bmp(ImagenBMP* img) {
+    if (img->header) munmap((void*) img->header, img->tam_mapa);
+    memset(img, 0, sizeof(ImagenBMP));
+}
+
+// Crea el archivo de salida con tam_mapa bytes y lo mapea en salida->mapa. Si algo falla
+// después de crearlo se borra: un archivo vacío o corto en el destino pasaría por una
+// salida válida para la caché y para quien salta imágenes ya procesadas.
+int abrir_salida_mapeada(const char* ruta, size_t tam_mapa, SalidaBMP* salida) {
+    if (salidas_en_memoria) {
+        void* mapa = mmap(NULL, tam_mapa, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapa == MAP_FAILED) {
+            fprintf(stderr, "[ERROR] No se pudo reservar %zu bytes para %s\n", tam_mapa, ruta);
+            return -1;
+        }
+        const char* nombre = strrchr(ruta, '/');
+        salida->fd = -1;
+        salida->mapa = (unsigned char*) mapa;
+        salida->tam_mapa = tam_mapa;
+        salida->nombre = strdup(nombre ? nombre + 1 : ruta);
+        return 0;
+    }
+
+    // La salida anterior puede ser un enlace duro a otro archivo (p. ej. la caché de
+    // resultados); se crea un archivo nuevo en lugar de truncar el compartido.
+    unlink(ruta);
+    int fd = open(ruta, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Error al abrir archivo: %s\n", ruta);
+        return -1;
+    }
+    if (ftruncate(fd, tam_mapa) != 0) {
+        fprintf(stderr, "[ERROR] No se pudo reservar %zu bytes para %s\n", tam_mapa, ruta);
+        close(fd);
+        unlink(ruta);
+        return -1;
+    }
+
+    void* mapa = mmap(NULL, tam_mapa, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapa == MAP_FAILED) {
+        fprintf(stderr, "[ERROR] No se pudo mapear %s\n", ruta);
+        close(fd);
+        unlink(ruta);
+        return -1;
+    }
+
+    salida->fd = fd;
+    salida->mapa = (unsigned char*) mapa;
+    salida->tam_mapa = tam_mapa;
+    return 0;
+}
+
+// Crea la salida con el tamaño final (encabezado + pixeles) y copia el encabezado de img.
+int crear_salida_bmp(const char* ruta, const ImagenBMP* img, SalidaBMP* salida) {
+    memset(salida, 0, sizeof(SalidaBMP));
+    salida->fd = -1;
+
+    if (!ruta) {
+        salida->data = (unsigned char*) pool_tomar(img->tam);
+        return salida->data ? 0 : -1;
+    }
+
+    if (abrir_salida_mapeada(ruta, (size_t)img->offset_pixels + img->tam, salida) != 0) return -1;
+    salida->data = salida->mapa + img->offset_pixels;
+    memcpy(salida->mapa, img->header, img->offset_pixels);
+    return 0;
+}
+
+// Salida en grises de 8 bits con paleta de 256 grises: un byte por pixel y filas
+// alineadas a 4 bytes, un tercio del tamaño de la versión de 24 bits.
+#define BMP_GRIS8_OFFSET (14 + 40 + 256 * 4)
+
+int fila_gris8(int ancho) {
+    return (ancho + 3) & (~3);
+}
+
+size_t tam_gris8(const ImagenBMP* img) {
+    return (size_t)fila_gris8(img->ancho) * img->alto;
+}
+
+void escribir_encabezado_gris8(unsigned char* h, const ImagenBMP* img) {
+    size_t tam = tam_gris8(img);
+    memset(h, 0, BMP_GRIS8_OFFSET);
+    h[0] = 'B';
+    h[1] = 'M';
+    *(int*)&h[2] = (int)(BMP_GRIS8_OFFSET + tam);
+    *(int*)&h[10] = BMP_GRIS8_OFFSET;
+    *(int*)&h[14] = 40;
+    *(int*)&h[18] = img->ancho;
+    *(int*)&h[22] = img->top_down ? -img->alto : img->alto;
+    *(short*)&h[26] = 1;
+    *(short*)&h[28] = 8;
+    *(int*)&h[34] = (int)tam;
+    memcpy(&h[38], &img->header[38], 8);      // resolución horizontal y vertical de la entrada
+    *(int*)&h[46] = 256;
+
+    unsigned char* paleta = h + 54;
+    for (int i = 0; i < 256; i++) {
+        paleta[i * 4 + 0] = paleta[i * 4 + 1] = paleta[i * 4 + 2] = (unsigned char) i;
+    }
+}
+
+int crear_salida_bmp_gris8(const char* ruta, const ImagenBMP* img, SalidaBMP* salida) {
+    memset(salida, 0, sizeof(SalidaBMP));
+    salida->fd = -1;
+
+    if (!ruta) {
+        salida->data = (unsigned char*) pool_tomar(tam_gris8(img));
+        return salida->data ? 0 : -1;
+    }
+
+    if (abrir_salida_mapeada(ruta, BMP_GRIS8_OFFSET + tam_gris8(img), salida) != 0) return -1;
+    salida->data = salida->mapa + BMP_GRIS8_OFFSET;
+    escribir_encabezado_gris8(salida->mapa, img);
+    return 0;
+}
+
+// Una salida en memoria se descarta; para guardarla se entrega (entregar_salida).
+void cerrar_salida_bmp(SalidaBMP* salida) {
+    if (salida->mapa) {
+        munmap(salida->mapa, salida->tam_mapa);
+        if (salida->fd >= 0) close(salida->fd);
+    } else {
+        pool_devolver(salida->data);
+    }
+    free(salida->nombre);
+    memset(salida, 0, sizeof(SalidaBMP));
+    salida->fd = -1;
+}
+
+// Escribe un buffer de pixeles ya calculado con el encabezado de img.
+int guardar_bmp(const char* ruta, const ImagenBMP* img, const unsigned char* data) {
+    SalidaBMP salida;
+    if (crear_salida_bmp(ruta, img, &salida) != 0) return -1;
+    memcpy(salida.data, data, img->tam);
+    cerrar_salida_bmp(&salida);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,193 @@
+// cache_resultados.h
+#ifndef CACHE_RESULTADOS_H
+#define CACHE_RESULTADOS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "contadores_hw.h"
+#include "escritura_async.h"
+
+// Caché persistente de resultados. La clave de cada salida es el hash del contenido del
+// BMP de entrada, su tamaño, el filtro y sus parámetros (el kernel en el blur), así que
+// renombrar o volver a copiar una imagen no invalida nada y cambiar el kernel solo
+// recalcula el blur. Un acierto enlaza (o copia) la salida guardada en el destino sin
+// calcular nada; un fallo calcula y enlaza la salida en la caché cuando ya está en disco.
+//
+// Se activa con FILTROS_CACHE_DIR=<dir>, que tiene que estar en el mismo sistema de
+// archivos que el destino: guardar es solo un enlace duro. Si no lo está se avisa y no
+// se guarda nada (copiar cada salida y su fsync haría más lenta la primera corrida).
+// FILTROS_CACHE_MAX_MB acota el tamaño: al final de cada trabajo se borran las entradas
+// usadas hace más tiempo hasta bajar al 90%. FILTROS_SIN_CACHE=1 la desactiva igual.
+// GUI.py las define al lanzar mpiexec; el modo servicio toma las de su propio arranque.
+
+int cache_activa = 0;
+int cache_guardar_activo = 0;   // 0 si la caché no está en el sistema de archivos del destino
+char cache_dir[512];
+long long cache_max_bytes = 0;
+long long cache_aciertos[N_FILTROS];
+long long cache_fallos[N_FILTROS];
+
+void cache_iniciar(const char* destino, int rank) {
+    const char* sin = getenv("FILTROS_SIN_CACHE");
+    const char* dir = getenv("FILTROS_CACHE_DIR");
+    const char* max = getenv("FILTROS_CACHE_MAX_MB");
+
+    cache_activa = dir && dir[0] && !(sin && strcmp(sin, "1") == 0);
+    cache_guardar_activo = 0;
+    if (!cache_activa) return;
+
+    snprintf(cache_dir, sizeof(cache_dir), "%s", dir);
+    mkdir(cache_dir, 0755);
+    cache_max_bytes = max && atoll(max) > 0 ? atoll(max) << 20 : 0;
+
+    struct stat st_cache, st_destino;
+    cache_guardar_activo = stat(cache_dir, &st_cache) == 0 && stat(destino, &st_destino) == 0 &&
+                           st_cache.st_dev == st_destino.st_dev;
+    if (!cache_guardar_activo && rank == 0)
+        fprintf(stderr, "[AVISO] La caché %s no está en el sistema de archivos de %s; no se guardan salidas nuevas\n",
+                cache_dir, destino);
+}
+
+// Hash de 64 bits sobre palabras de 8 bytes en cuatro carriles independientes, para
+// que el costo de hashear quede por debajo del de leer el archivo.
+#define CACHE_PRIMO_1 0x9E3779B185EBCA87ULL
+#define CACHE_PRIMO_2 0xC2B2AE3D27D4EB4FULL
+#define CACHE_PRIMO_3 0x165667B19E3779F9ULL
+
+unsigned long long cache_rotar(unsigned long long x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+unsigned long long cache_ronda(unsigned long long acc, unsigned long long palabra) {
+    return cache_rotar(acc + palabra * CACHE_PRIMO_2, 31) * CACHE_PRIMO_1;
+}
+
+unsigned long long cache_hash(const unsigned char* p, size_t n) {
+    unsigned long long c[4] = { CACHE_PRIMO_1 + CACHE_PRIMO_2, CACHE_PRIMO_2, 0, -CACHE_PRIMO_1 };
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        for (int j = 0; j < 4; j++) {
+            unsigned long long w;
+            memcpy(&w, p + i + 8 * j, 8);
+            c[j] = cache_ronda(c[j], w);
+        }
+    }
+
+    unsigned long long h = cache_rotar(c[0], 1) + cache_rotar(c[1], 7) + cache_rotar(c[2], 12) + cache_rotar(c[3], 18);
+    h += (unsigned long long) n;
+    for (; i < n; i++) {
+        h ^= p[i] * CACHE_PRIMO_3;
+        h = cache_rotar(h, 11) * CACHE_PRIMO_1;
+    }
+
+    h ^= h >> 33;
+    h *= CACHE_PRIMO_2;
+    h ^= h >> 29;
+    h *= CACHE_PRIMO_3;
+    h ^= h >> 32;
+    return h;
+}
+
+// Ruta de la entrada de caché para una salida; kernel 0 si el filtro no tiene parámetros.
+// `variante` distingue formatos de una misma salida (p. ej. "8bits"); NULL si no hay.
+void cache_ruta(char* ruta, size_t tam, unsigned long long hash, size_t bytes, int filtro, int kernel,
+                const char* variante) {
+    char sufijo[32] = "";
+    if (kernel > 0) snprintf(sufijo, sizeof(sufijo), "_k%d", kernel);
+    else if (variante) snprintf(sufijo, sizeof(sufijo), "_%s", variante);
+    snprintf(ruta, tam, "%s/%016llx_%zu_%s%s.bmp", cache_dir, hash, bytes, nombres_filtros[filtro], sufijo);
+}
+
+// Intenta dejar la salida guardada en `out`. Devuelve 1 si hubo acierto.
+int cache_restaurar(const char* ruta_cache, const char* out, int filtro) {
+    if (!cache_activa) return 0;
+
+    struct stat st;
+    if (stat(ruta_cache, &st) == 0 && publicar_archivo(ruta_cache, out, 1) == 0) {
+        // La fecha de modificación marca el último uso para cache_recortar
+        if (cache_max_bytes > 0) utimensat(AT_FDCWD, ruta_cache, NULL, 0);
+        __atomic_add_fetch(&cache_aciertos[filtro], 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+    __atomic_add_fetch(&cache_fallos[filtro], 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+// Guarda `out` en la caché cuando todas las salidas de la imagen estén en disco.
+void cache_guardar(ImagenPendiente* pendiente, const char* out, const char* ruta_cache) {
+    if (cache_activa && cache_guardar_activo) imagen_pendiente_publicar(pendiente, out, ruta_cache);
+}
+
+// Guarda ya una salida que está en disco. Si el enlace cruza sistemas de archivos se
+// deja de guardar en lugar de copiar.
+void cache_guardar_ahora(const char* out, const char* ruta_cache) {
+    if (!cache_activa || !cache_guardar_activo) return;
+    if (publicar_archivo(out, ruta_cache, 0) != 0 && errno == EXDEV) {
+        fprintf(stderr, "[AVISO] La caché %s está en otro sistema de archivos; no se guardan salidas nuevas\n", cache_dir);
+        cache_guardar_activo = 0;
+    }
+}
+
+typedef struct {
+    char nombre[256];
+    long long bytes;
+    struct timespec uso;
+} EntradaCache;
+
+int cache_comparar_uso(const void* a, const void* b) {
+    const EntradaCache* x = (const EntradaCache*) a;
+    const EntradaCache* y = (const EntradaCache*) b;
+    if (x->uso.tv_sec != y->uso.tv_sec) return x->uso.tv_sec < y->uso.tv_sec ? -1 : 1;
+    return x->uso.tv_nsec < y->uso.tv_nsec ? -1 : (x->uso.tv_nsec > y->uso.tv_nsec);
+}
+
+// Con FILTROS_CACHE_MAX_MB, borra las entradas menos usadas hasta dejar la caché en el
+// 90% del límite. Los temporales de publicar_archivo (sin extensión .bmp) no cuentan.
+void cache_recortar() {
+    if (!cache_activa || cache_max_bytes <= 0) return;
+    DIR* dir = opendir(cache_dir);
+    if (!dir) return;
+
+    EntradaCache* entradas = NULL;
+    int n = 0, cap = 0;
+    long long total = 0;
+    struct dirent* e;
+    while ((e = readdir(dir))) {
+        size_t largo = strlen(e->d_name);
+        if (largo < 5 || largo >= sizeof(entradas[0].nombre) || strcmp(e->d_name + largo - 4, ".bmp") != 0) continue;
+
+        char ruta[1024];
+        struct stat st;
+        snprintf(ruta, sizeof(ruta), "%s/%s", cache_dir, e->d_name);
+        if (stat(ruta, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+        if (n == cap) {
+            cap = cap ? 2 * cap : 256;
+            entradas = (EntradaCache*) realloc(entradas, cap * sizeof(EntradaCache));
+        }
+        snprintf(entradas[n].nombre, sizeof(entradas[n].nombre), "%s", e->d_name);
+        entradas[n].bytes = st.st_size;
+        entradas[n].uso = st.st_mtim;
+        total += st.st_size;
+        n++;
+    }
+    closedir(dir);
+
+    if (total > cache_max_bytes) {
+        qsort(entradas, n, sizeof(EntradaCache), cache_comparar_uso);
+        long long objetivo = cache_max_bytes / 10 * 9;
+        for (int i = 0; i < n && total > objetivo; i++) {
+            char ruta[1024];
+            snprintf(ruta, sizeof(ruta), "%s/%s", cache_dir, entradas[i].nombre);
+            if (unlink(ruta) == 0) total -= entradas[i].bytes;
+        }
+    }
+    free(entradas);
+}
+
+#endif
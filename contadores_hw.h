@@ -0,0 +1,247 @@
+// contadores_hw.h
+#ifndef CONTADORES_HW_H
+#define CONTADORES_HW_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <omp.h>
+#include "energia.h"
+
+// Contadores de hardware por filtro y por hilo con perf_event_open (instrucciones,
+// ciclos y fallos de caché, solo en modo usuario). Cada hilo abre sus contadores la
+// primera vez que mide. Si el kernel o la VM no los ofrecen (sin PMU, paranoid alto)
+// se mide solo el tiempo y los bytes, y los contadores quedan en -1.
+// FILTROS_SIN_CONTADORES=1 los desactiva. Cada medición también toma la energía de la
+// fase con energia_leer (energia.h).
+
+#define N_EVENTOS_HW 3
+#define MAX_HILOS_HW 256
+
+enum { HW_INSTRUCCIONES, HW_CICLOS, HW_FALLOS_CACHE };
+
+enum {
+    FILTRO_GRISES,
+    FILTRO_ESPEJO_H_COLOR,
+    FILTRO_ESPEJO_V_COLOR,
+    FILTRO_ESPEJO_H_GRIS,
+    FILTRO_ESPEJO_V_GRIS,
+    FILTRO_BLUR,
+    FILTRO_GRISES_ESPEJOS,         // pasada fusionada de grises y espejos (varias salidas)
+    N_FILTROS
+};
+
+const char* nombres_filtros[N_FILTROS] = {
+    "grises", "espejo_horizontal_color", "espejo_vertical_color",
+    "espejo_horizontal_gris", "espejo_vertical_gris", "blur", "grises_espejos"
+};
+
+// Acumulado de un filtro en un hilo. Los contadores valen -1 si no hubo medición.
+typedef struct {
+    long long invocaciones;
+    long long eventos[N_EVENTOS_HW];
+    long long lecturas;
+    long long escrituras;
+    double tiempo;
+    double energia;                // joules muestreados durante las fases del filtro
+} EstadisticaFiltro;
+
+// Medición en curso: lecturas iniciales de cada hilo participante y, al terminar,
+// la diferencia total.
+typedef struct {
+    int filtro;
+    int equipo;                    // 1 si el filtro reparte trabajo entre los hilos
+    int hilos;
+    int hilo_llamador;
+    double t0;
+    double tiempo;
+    double energia0;
+    double energia;
+    long long inicio[MAX_HILOS_HW][N_EVENTOS_HW];
+    long long delta[MAX_HILOS_HW][N_EVENTOS_HW];
+    long long total[N_EVENTOS_HW];
+} MedicionHW;
+
+EstadisticaFiltro estadisticas_hw[MAX_HILOS_HW][N_FILTROS];
+__thread int contador_fd[N_EVENTOS_HW] = { -2, -2, -2 };
+
+int filtro_indice(const char* tipo) {
+    for (int i = 0; i < N_FILTROS; i++) {
+        if (strcmp(nombres_filtros[i], tipo) == 0) return i;
+    }
+    return FILTRO_GRISES;
+}
+
+void contadores_abrir_hilo() {
+    static const unsigned long long configs[N_EVENTOS_HW] = {
+        PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES
+    };
+    const char* sin = getenv("FILTROS_SIN_CONTADORES");
+
+    for (int e = 0; e < N_EVENTOS_HW; e++) {
+        contador_fd[e] = -1;
+        if (sin && strcmp(sin, "1") == 0) continue;
+
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[e];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        contador_fd[e] = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+}
+
+// Lee los contadores del hilo actual; -1 en los que no están disponibles.
+void contadores_leer_hilo(long long* valores) {
+    if (contador_fd[0] == -2) contadores_abrir_hilo();
+
+    for (int e = 0; e < N_EVENTOS_HW; e++) {
+        unsigned long long v;
+        if (contador_fd[e] < 0 || read(contador_fd[e], &v, sizeof(v)) != sizeof(v))
+            valores[e] = -1;
+        else
+            valores[e] = (long long) v;
+    }
+}
+
+int hilo_actual_hw() {
+    int t = omp_get_thread_num();
+    return t < MAX_HILOS_HW ? t : MAX_HILOS_HW - 1;
+}
+
+// Con `equipo`, fuera de una región paralela se toma la lectura de cada hilo del
+// equipo OpenMP (el filtro repartirá sus filas entre ellos); si no, solo del hilo actual.
+void medicion_iniciar(MedicionHW* m, int filtro, int equipo) {
+    m->filtro = filtro;
+    m->equipo = equipo && !omp_in_parallel();
+    m->hilo_llamador = hilo_actual_hw();
+    m->hilos = 1;
+
+    if (m->equipo) {
+        #pragma omp parallel
+        {
+            int t = hilo_actual_hw();
+            contadores_leer_hilo(m->inicio[t]);
+            #pragma omp single
+            m->hilos = omp_get_num_threads() < MAX_HILOS_HW ? omp_get_num_threads() : MAX_HILOS_HW;
+        }
+    } else {
+        contadores_leer_hilo(m->inicio[m->hilo_llamador]);
+    }
+    m->energia0 = energia_leer();
+    m->t0 = omp_get_wtime();
+}
+
+void medicion_terminar(MedicionHW* m) {
+    m->tiempo = omp_get_wtime() - m->t0;
+    m->energia = energia_leer() - m->energia0;
+
+    if (m->equipo) {
+        #pragma omp parallel num_threads(m->hilos)
+        {
+            int t = hilo_actual_hw();
+            long long fin[N_EVENTOS_HW];
+            contadores_leer_hilo(fin);
+            for (int e = 0; e < N_EVENTOS_HW; e++)
+                m->delta[t][e] = (fin[e] < 0 || m->inicio[t][e] < 0) ? -1 : fin[e] - m->inicio[t][e];
+        }
+    } else {
+        long long fin[N_EVENTOS_HW];
+        int t = m->hilo_llamador;
+        contadores_leer_hilo(fin);
+        for (int e = 0; e < N_EVENTOS_HW; e++)
+            m->delta[t][e] = (fin[e] < 0 || m->inicio[t][e] < 0) ? -1 : fin[e] - m->inicio[t][e];
+    }
+
+    for (int e = 0; e < N_EVENTOS_HW; e++) {
+        m->total[e] = 0;
+        int ini = m->equipo ? 0 : m->hilo_llamador;
+        int fin = m->equipo ? m->hilos : m->hilo_llamador + 1;
+        for (int t = ini; t < fin; t++) {
+            if (m->delta[t][e] < 0) { m->total[e] = -1; break; }
+            m->total[e] += m->delta[t][e];
+        }
+    }
+}
+
+// Acumula la medición en las estadísticas de cada hilo que participó. El tiempo de
+// pared se anota solo al hilo que llamó al filtro para no contarlo varias veces.
+void medicion_registrar(const MedicionHW* m, long long lecturas, long long escrituras) {
+    int ini = m->equipo ? 0 : m->hilo_llamador;
+    int fin = m->equipo ? m->hilos : m->hilo_llamador + 1;
+
+    for (int t = ini; t < fin; t++) {
+        EstadisticaFiltro* est = &estadisticas_hw[t][m->filtro];
+        for (int e = 0; e < N_EVENTOS_HW; e++) {
+            if (m->delta[t][e] < 0) est->eventos[e] = -1;
+            else if (est->eventos[e] >= 0) est->eventos[e] += m->delta[t][e];
+        }
+    }
+
+    EstadisticaFiltro* est = &estadisticas_hw[m->hilo_llamador][m->filtro];
+    est->invocaciones++;
+    est->lecturas += lecturas;
+    est->escrituras += escrituras;
+    est->tiempo += m->tiempo;
+    est->energia += m->energia;
+}
+
+// Suma por filtro de todos los hilos del proceso, lista para reducir con MPI:
+// por filtro [invocaciones, instrucciones, ciclos, fallos_cache, lecturas, escrituras]
+// y en tiempos[] y energia[] el tiempo de pared y los joules acumulados. Un contador en
+// -1 indica que algún hilo no pudo medirlo; se reporta en `sin_contadores`.
+#define CAMPOS_FILTRO_HW 6
+
+void contadores_resumen_proceso(long long* valores, double* tiempos, double* energia, int* sin_contadores) {
+    *sin_contadores = 0;
+    for (int f = 0; f < N_FILTROS; f++) {
+        long long* v = valores + f * CAMPOS_FILTRO_HW;
+        memset(v, 0, CAMPOS_FILTRO_HW * sizeof(long long));
+        tiempos[f] = 0;
+        energia[f] = 0;
+
+        for (int t = 0; t < MAX_HILOS_HW; t++) {
+            const EstadisticaFiltro* est = &estadisticas_hw[t][f];
+            v[0] += est->invocaciones;
+            for (int e = 0; e < N_EVENTOS_HW; e++) {
+                if (est->eventos[e] < 0) *sin_contadores = 1;
+                else v[1 + e] += est->eventos[e];
+            }
+            v[4] += est->lecturas;
+            v[5] += est->escrituras;
+            tiempos[f] += est->tiempo;
+            energia[f] += est->energia;
+        }
+    }
+}
+
+// Borra lo acumulado, para medir cada trabajo por separado en el modo servicio
+void contadores_reiniciar() {
+    memset(estadisticas_hw, 0, sizeof(estadisticas_hw));
+}
+
+// Detalle por hilo y filtro de este proceso
+void contadores_escribir_detalle(const char* ruta, int rank) {
+    FILE* f = fopen(ruta, "w");
+    if (!f) return;
+
+    fprintf(f, "Proceso %d (-1: contador no disponible)\n", rank);
+    fprintf(f, "%-6s %-26s %10s %16s %16s %14s %12s\n",
+            "Hilo", "Filtro", "Llamadas", "Instrucciones", "Ciclos", "Fallos cache", "Tiempo (s)");
+    for (int t = 0; t < MAX_HILOS_HW; t++) {
+        for (int fi = 0; fi < N_FILTROS; fi++) {
+            const EstadisticaFiltro* est = &estadisticas_hw[t][fi];
+            if (est->invocaciones == 0 && est->eventos[HW_INSTRUCCIONES] == 0) continue;
+            fprintf(f, "%-6d %-26s %10lld %16lld %16lld %14lld %12.6f\n", t, nombres_filtros[fi], est->invocaciones,
+                    est->eventos[HW_INSTRUCCIONES], est->eventos[HW_CICLOS], est->eventos[HW_FALLOS_CACHE], est->tiempo);
+        }
+    }
+    fclose(f);
+}
+
+#endif
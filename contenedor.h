@@ -0,0 +1,301 @@
+// contenedor.h
+#ifndef CONTENEDOR_H
+#define CONTENEDOR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Contenedor de salidas: en lugar de un archivo por salida y otro por log, cada proceso
+// agrega todo a un único archivo propio, solo al final y con escrituras grandes. Con
+// miles de imágenes chicas, crear archivos y actualizar metadatos en el disco compartido
+// cuesta más que los pixeles.
+//
+// FILTROS_CONTENEDOR=carpeta lo activa: el proceso r escribe en carpeta/salidas_r<r>.fcn.
+// Las salidas se arman en memoria (bmp_io.h) y los hilos escritores las agregan.
+// extraer_contenedor.c lista y desempaqueta las entradas.
+//
+// Formato (enteros little-endian):
+//   registro  "FCR1" u32 largo_nombre, u64 largo_datos, nombre, datos
+//   índice    "FCI1" u32 entradas, u64 bytes, { u64 offset_datos, u64 largo, u32 largo_nombre, nombre }...
+//   pie       "FCP1" u32 entradas, u64 offset_indice
+// Al cerrar se agrega un índice con todas las entradas del archivo y el pie, que queda
+// al final: el lector va directo al índice y de ahí a cualquier salida por nombre. Una
+// corrida nueva sigue agregando después del pie anterior. Si el archivo quedó sin pie
+// (corrida interrumpida), el índice se reconstruye recorriendo los registros.
+
+#define CONTENEDOR_BUFFER ((size_t)8 << 20)
+#define CONTENEDOR_PIE 16
+
+typedef struct {
+    unsigned long long offset;
+    unsigned long long largo;
+    char* nombre;
+} EntradaContenedor;
+
+typedef struct {
+    int fd;
+    unsigned long long fin;         // offset del próximo registro
+    unsigned char* buffer;
+    size_t en_buffer;
+    EntradaContenedor* entradas;
+    int n_entradas;
+    int capacidad;
+    int error;
+    pthread_mutex_t mutex;
+} Contenedor;
+
+Contenedor contenedor = { -1, 0, NULL, 0, NULL, 0, 0, 0, PTHREAD_MUTEX_INITIALIZER };
+int contenedor_activo = 0;
+
+void contenedor_indexar(EntradaContenedor** entradas, int* n, int* capacidad, const char* nombre, size_t largo_nombre,
+                        unsigned long long offset, unsigned long long largo) {
+    if (*n == *capacidad) {
+        *capacidad = *capacidad ? *capacidad * 2 : 1024;
+        *entradas = (EntradaContenedor*) realloc(*entradas, *capacidad * sizeof(EntradaContenedor));
+    }
+    EntradaContenedor* e = &(*entradas)[(*n)++];
+    e->offset = offset;
+    e->largo = largo;
+    e->nombre = (char*) malloc(largo_nombre + 1);
+    memcpy(e->nombre, nombre, largo_nombre);
+    e->nombre[largo_nombre] = '\0';
+}
+
+int contenedor_leer_todo(int fd, void* dst, size_t largo, unsigned long long offset) {
+    unsigned char* p = (unsigned char*) dst;
+    while (largo > 0) {
+        ssize_t r = pread(fd, p, largo, offset);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return -1;
+        p += r;
+        offset += r;
+        largo -= r;
+    }
+    return 0;
+}
+
+// Índice desde el pie; si no hay pie válido se recorren los registros. *valido queda en
+// el offset hasta donde el archivo es legible (el resto es una escritura interrumpida).
+// Devuelve 0 si se pudo leer.
+int contenedor_leer_indice(int fd, EntradaContenedor** entradas, int* n, unsigned long long* valido) {
+    struct stat st;
+    *entradas = NULL;
+    *n = 0;
+    int capacidad = 0;
+    if (fstat(fd, &st) != 0) return -1;
+    unsigned long long tam = st.st_size;
+    *valido = tam;
+
+    unsigned char pie[CONTENEDOR_PIE];
+    if (tam >= CONTENEDOR_PIE && contenedor_leer_todo(fd, pie, CONTENEDOR_PIE, tam - CONTENEDOR_PIE) == 0 &&
+        memcmp(pie, "FCP1", 4) == 0) {
+        unsigned int total;
+        unsigned long long offset_indice;
+        memcpy(&total, pie + 4, 4);
+        memcpy(&offset_indice, pie + 8, 8);
+
+        unsigned char cabecera[16];
+        if (offset_indice + 16 <= tam && contenedor_leer_todo(fd, cabecera, 16, offset_indice) == 0 &&
+            memcmp(cabecera, "FCI1", 4) == 0) {
+            unsigned long long bytes;
+            memcpy(&bytes, cabecera + 8, 8);
+            unsigned char* indice = (unsigned char*) malloc(bytes > 0 ? bytes : 1);
+            if (offset_indice + 16 + bytes <= tam && contenedor_leer_todo(fd, indice, bytes, offset_indice + 16) == 0) {
+                size_t pos = 0;
+                for (unsigned int i = 0; i < total && pos + 20 <= bytes; i++) {
+                    unsigned long long offset, largo;
+                    unsigned int largo_nombre;
+                    memcpy(&offset, indice + pos, 8);
+                    memcpy(&largo, indice + pos + 8, 8);
+                    memcpy(&largo_nombre, indice + pos + 16, 4);
+                    if (pos + 20 + largo_nombre > bytes) break;
+                    contenedor_indexar(entradas, n, &capacidad, (const char*)indice + pos + 20, largo_nombre, offset, largo);
+                    pos += 20 + largo_nombre;
+                }
+                free(indice);
+                if (*n == (int) total) return 0;
+            } else {
+                free(indice);
+            }
+        }
+        for (int i = 0; i < *n; i++) free((*entradas)[i].nombre);
+        *n = 0;
+    }
+
+    // Sin pie: se recorren los bloques desde el principio
+    unsigned long long pos = 0;
+    char nombre[4096];
+    while (pos + 16 <= tam) {
+        unsigned char cabecera[16];
+        if (contenedor_leer_todo(fd, cabecera, 16, pos) != 0) break;
+        if (memcmp(cabecera, "FCR1", 4) == 0) {
+            unsigned int largo_nombre;
+            unsigned long long largo;
+            memcpy(&largo_nombre, cabecera + 4, 4);
+            memcpy(&largo, cabecera + 8, 8);
+            unsigned long long datos = pos + 16 + largo_nombre;
+            if (largo_nombre >= sizeof(nombre) || datos + largo > tam ||
+                contenedor_leer_todo(fd, nombre, largo_nombre, pos + 16) != 0) break;
+            contenedor_indexar(entradas, n, &capacidad, nombre, largo_nombre, datos, largo);
+            pos = datos + largo;
+        } else if (memcmp(cabecera, "FCI1", 4) == 0) {
+            unsigned long long bytes;
+            memcpy(&bytes, cabecera + 8, 8);
+            if (pos + 16 + bytes > tam) break;
+            pos += 16 + bytes;
+        } else if (memcmp(cabecera, "FCP1", 4) == 0) {
+            pos += CONTENEDOR_PIE;
+        } else {
+            break;
+        }
+    }
+    *valido = pos;
+    return 0;
+}
+
+void contenedor_liberar_indice(EntradaContenedor* entradas, int n) {
+    for (int i = 0; i < n; i++) free(entradas[i].nombre);
+    free(entradas);
+}
+
+// Con el mutex tomado: escribe el buffer y lo deja vacío
+void contenedor_vaciar(Contenedor* c) {
+    const unsigned char* p = c->buffer;
+    size_t largo = c->en_buffer;
+    while (largo > 0 && !c->error) {
+        ssize_t w = write(c->fd, p, largo);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) {
+            perror("Error escribiendo el contenedor de salidas");
+            c->error = 1;
+            break;
+        }
+        p += w;
+        largo -= w;
+    }
+    c->en_buffer = 0;
+}
+
+// Con el mutex tomado: agrega bytes al archivo pasando por el buffer; lo que no entra
+// en el buffer se escribe directo, sin copiarlo.
+void contenedor_escribir(Contenedor* c, const void* datos, size_t largo) {
+    if (c->en_buffer + largo > CONTENEDOR_BUFFER) contenedor_vaciar(c);
+    if (largo >= CONTENEDOR_BUFFER) {
+        unsigned char* guardado = c->buffer;
+        c->buffer = (unsigned char*) datos;
+        c->en_buffer = largo;
+        contenedor_vaciar(c);
+        c->buffer = guardado;
+    } else {
+        memcpy(c->buffer + c->en_buffer, datos, largo);
+        c->en_buffer += largo;
+    }
+    c->fin += largo;
+}
+
+// Abre (o crea) el contenedor de este proceso. Devuelve 0 si quedó activo.
+int contenedor_iniciar(int rank) {
+    const char* carpeta = getenv("FILTROS_CONTENEDOR");
+    if (!carpeta || !carpeta[0]) return -1;
+
+    char ruta[1024];
+    mkdir(carpeta, 0755);
+    snprintf(ruta, sizeof(ruta), "%s/salidas_r%d.fcn", carpeta, rank);
+    Contenedor* c = &contenedor;
+    c->fd = open(ruta, O_RDWR | O_CREAT, 0644);
+    if (c->fd < 0) {
+        fprintf(stderr, "No se pudo abrir el contenedor '%s': %s\n", ruta, strerror(errno));
+        return -1;
+    }
+
+    // Las entradas de corridas anteriores siguen en el índice nuevo
+    unsigned long long valido;
+    contenedor_leer_indice(c->fd, &c->entradas, &c->n_entradas, &valido);
+    c->capacidad = c->n_entradas;
+    struct stat st;
+    if (fstat(c->fd, &st) == 0 && valido < (unsigned long long) st.st_size) {
+        fprintf(stderr, "Contenedor '%s' incompleto: se descartan %llu bytes finales\n", ruta,
+                (unsigned long long) st.st_size - valido);
+        if (ftruncate(c->fd, valido) != 0) perror("ftruncate");
+    }
+    c->fin = lseek(c->fd, valido, SEEK_SET);
+    c->buffer = (unsigned char*) malloc(CONTENEDOR_BUFFER);
+    c->en_buffer = 0;
+    c->error = 0;
+    contenedor_activo = 1;
+    return 0;
+}
+
+// Agrega una entrada. Seguro desde cualquier hilo.
+void contenedor_agregar(const char* nombre, const void* datos, size_t largo) {
+    Contenedor* c = &contenedor;
+    unsigned int largo_nombre = strlen(nombre);
+    unsigned long long largo_datos = largo;
+    unsigned char cabecera[16];
+    memcpy(cabecera, "FCR1", 4);
+    memcpy(cabecera + 4, &largo_nombre, 4);
+    memcpy(cabecera + 8, &largo_datos, 8);
+
+    pthread_mutex_lock(&c->mutex);
+    contenedor_escribir(c, cabecera, 16);
+    contenedor_escribir(c, nombre, largo_nombre);
+    contenedor_indexar(&c->entradas, &c->n_entradas, &c->capacidad, nombre, largo_nombre, c->fin, largo);
+    contenedor_escribir(c, datos, largo);
+    pthread_mutex_unlock(&c->mutex);
+}
+
+// Escribe el índice y el pie, hace fsync y cierra. Devuelve 0 si todo quedó en disco.
+int contenedor_finalizar() {
+    Contenedor* c = &contenedor;
+    if (!contenedor_activo) return 0;
+
+    pthread_mutex_lock(&c->mutex);
+    unsigned long long bytes = 0;
+    for (int i = 0; i < c->n_entradas; i++) bytes += 20 + strlen(c->entradas[i].nombre);
+
+    unsigned long long offset_indice = c->fin;
+    unsigned int total = c->n_entradas;
+    unsigned char cabecera[16];
+    memcpy(cabecera, "FCI1", 4);
+    memcpy(cabecera + 4, &total, 4);
+    memcpy(cabecera + 8, &bytes, 8);
+    contenedor_escribir(c, cabecera, 16);
+    for (int i = 0; i < c->n_entradas; i++) {
+        EntradaContenedor* e = &c->entradas[i];
+        unsigned int largo_nombre = strlen(e->nombre);
+        unsigned char entrada[20];
+        memcpy(entrada, &e->offset, 8);
+        memcpy(entrada + 8, &e->largo, 8);
+        memcpy(entrada + 16, &largo_nombre, 4);
+        contenedor_escribir(c, entrada, 20);
+        contenedor_escribir(c, e->nombre, largo_nombre);
+    }
+
+    unsigned char pie[CONTENEDOR_PIE];
+    memcpy(pie, "FCP1", 4);
+    memcpy(pie + 4, &total, 4);
+    memcpy(pie + 8, &offset_indice, 8);
+    contenedor_escribir(c, pie, CONTENEDOR_PIE);
+    contenedor_vaciar(c);
+    if (fsync(c->fd) != 0) c->error = 1;
+    close(c->fd);
+    int error = c->error;
+
+    contenedor_liberar_indice(c->entradas, c->n_entradas);
+    free(c->buffer);
+    c->fd = -1;
+    c->buffer = NULL;
+    c->entradas = NULL;
+    c->n_entradas = c->capacidad = 0;
+    contenedor_activo = 0;
+    pthread_mutex_unlock(&c->mutex);
+    return error ? -1 : 0;
+}
+
+#endif
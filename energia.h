@@ -0,0 +1,198 @@
+// energia.h
+#ifndef ENERGIA_H
+#define ENERGIA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+// Energía medida por corrida y por fase de filtro. Toda fuente se ve como un contador
+// acumulado en joules (energia_leer); una medición es la diferencia entre dos lecturas.
+//
+//   rapl     /sys/class/powercap/intel-rapl:N/energy_uj de cada paquete. El contador da
+//            la vuelta en max_energy_range_uj; se acumulan las diferencias (sin rango
+//            conocido, una vuelta cuenta 0). Mide el nodo.
+//   archivo  FILTROS_ENERGIA_ARCHIVO tiene el acumulado del nodo en joules (un medidor
+//            externo o IPMI lo actualiza; sirve también para pruebas). Queda abierto y se
+//            relee con pread, así que el medidor tiene que reescribirlo en el lugar.
+//   modelo   tiempo de pared del proceso por FILTROS_ENERGIA_WATTS watts por proceso.
+//            Por defecto 26 W: los 339 W medios del modelo semanal anterior (13.559 kWh en
+//            40 horas) repartidos entre sus 13 procesos. Es por proceso y no por hilo: el
+//            tiempo de CPU sumaría todos los hilos y cobraría 26 W a cada uno.
+//
+// FILTROS_ENERGIA=rapl|archivo|modelo elige una. Si no, se usa el archivo si está
+// definido, RAPL si se puede leer (suele requerir permisos sobre energy_uj) y si no el
+// modelo. Las fuentes de nodo se cuentan una sola vez por nodo (energia_corrida).
+
+#define ENERGIA_MAX_ZONAS 16
+#define ENERGIA_WATTS_PROCESO 26.0
+
+enum { ENERGIA_RAPL, ENERGIA_ARCHIVO, ENERGIA_MODELO, ENERGIA_N_FUENTES };
+
+typedef struct {
+    const char* nombre;
+    int por_nodo;               // mide todo el nodo, no solo este proceso
+    int (*iniciar)(void);       // 0 si la fuente se puede usar
+    double (*leer)(void);       // joules acumulados
+} FuenteEnergia;
+
+pthread_mutex_t energia_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+int rapl_fd[ENERGIA_MAX_ZONAS];
+unsigned long long rapl_ultimo[ENERGIA_MAX_ZONAS];
+unsigned long long rapl_rango[ENERGIA_MAX_ZONAS];
+int rapl_zonas = 0;
+double rapl_acumulado = 0;
+
+int leer_ull_fd(int fd, unsigned long long* v) {
+    char buf[32];
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) return -1;
+    buf[n] = '\0';
+    *v = strtoull(buf, NULL, 10);
+    return 0;
+}
+
+// Zonas de primer nivel (un paquete cada una); psys ya incluye a los paquetes y se omite
+int rapl_iniciar() {
+    DIR* dir = opendir("/sys/class/powercap");
+    if (!dir) return -1;
+
+    struct dirent* e;
+    while ((e = readdir(dir)) && rapl_zonas < ENERGIA_MAX_ZONAS) {
+        if (strncmp(e->d_name, "intel-rapl:", 11) != 0 || strchr(e->d_name + 11, ':')) continue;
+
+        char ruta[512], nombre[64] = "";
+        snprintf(ruta, sizeof(ruta), "/sys/class/powercap/%s/name", e->d_name);
+        FILE* f = fopen(ruta, "r");
+        if (f) {
+            if (!fgets(nombre, sizeof(nombre), f)) nombre[0] = '\0';
+            fclose(f);
+        }
+        if (strncmp(nombre, "psys", 4) == 0) continue;
+
+        snprintf(ruta, sizeof(ruta), "/sys/class/powercap/%s/energy_uj", e->d_name);
+        int fd = open(ruta, O_RDONLY);
+        unsigned long long v;
+        if (fd < 0) continue;
+        if (leer_ull_fd(fd, &v) != 0) {
+            close(fd);
+            continue;
+        }
+
+        unsigned long long rango = 0;
+        snprintf(ruta, sizeof(ruta), "/sys/class/powercap/%s/max_energy_range_uj", e->d_name);
+        int fd_rango = open(ruta, O_RDONLY);
+        if (fd_rango >= 0) {
+            leer_ull_fd(fd_rango, &rango);
+            close(fd_rango);
+        }
+        rapl_fd[rapl_zonas] = fd;
+        rapl_ultimo[rapl_zonas] = v;
+        rapl_rango[rapl_zonas] = rango;
+        rapl_zonas++;
+    }
+    closedir(dir);
+    return rapl_zonas > 0 ? 0 : -1;
+}
+
+double rapl_leer() {
+    pthread_mutex_lock(&energia_mutex);
+    for (int z = 0; z < rapl_zonas; z++) {
+        unsigned long long v;
+        if (leer_ull_fd(rapl_fd[z], &v) != 0) continue;
+        // Sin max_energy_range_uj (o en 0) no se sabe cuánto se perdió en la vuelta
+        unsigned long long d = v >= rapl_ultimo[z] ? v - rapl_ultimo[z]
+                             : rapl_rango[z] > rapl_ultimo[z] ? v + rapl_rango[z] - rapl_ultimo[z] : 0;
+        rapl_acumulado += d * 1e-6;
+        rapl_ultimo[z] = v;
+    }
+    double total = rapl_acumulado;
+    pthread_mutex_unlock(&energia_mutex);
+    return total;
+}
+
+int archivo_fd = -1;
+double energia_archivo_ultimo = 0;
+
+int archivo_iniciar() {
+    const char* ruta = getenv("FILTROS_ENERGIA_ARCHIVO");
+    if (archivo_fd < 0 && ruta && ruta[0]) archivo_fd = open(ruta, O_RDONLY);
+    return archivo_fd >= 0 ? 0 : -1;
+}
+
+// Si el archivo no se puede leer en un momento dado se repite la última lectura
+double archivo_leer() {
+    char buf[64], *fin;
+    ssize_t n = pread(archivo_fd, buf, sizeof(buf) - 1, 0);
+    pthread_mutex_lock(&energia_mutex);
+    if (n > 0) {
+        buf[n] = '\0';
+        double v = strtod(buf, &fin);
+        if (fin != buf) energia_archivo_ultimo = v;
+    }
+    double v = energia_archivo_ultimo;
+    pthread_mutex_unlock(&energia_mutex);
+    return v;
+}
+
+double energia_watts_proceso = ENERGIA_WATTS_PROCESO;
+
+int modelo_iniciar() {
+    const char* env = getenv("FILTROS_ENERGIA_WATTS");
+    if (env && atof(env) > 0) energia_watts_proceso = atof(env);
+    return 0;
+}
+
+double modelo_leer() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec * 1e-9) * energia_watts_proceso;
+}
+
+FuenteEnergia fuentes_energia[ENERGIA_N_FUENTES] = {
+    { "rapl", 1, rapl_iniciar, rapl_leer },
+    { "archivo", 1, archivo_iniciar, archivo_leer },
+    { "modelo", 0, modelo_iniciar, modelo_leer },
+};
+
+int energia_fuente = -1;        // índice en fuentes_energia; -1 sin iniciar
+int energia_lider_nodo = 1;
+
+// `lider_nodo`: este proceso es el primero de su nodo y cuenta las fuentes de nodo.
+// Devuelve el índice de la fuente elegida.
+int energia_iniciar(int lider_nodo) {
+    energia_lider_nodo = lider_nodo;
+    const char* forzar = getenv("FILTROS_ENERGIA");
+    if (forzar && forzar[0]) {
+        for (int i = 0; i < ENERGIA_N_FUENTES; i++) {
+            if (strcmp(forzar, fuentes_energia[i].nombre) != 0) continue;
+            if (fuentes_energia[i].iniciar() == 0) energia_fuente = i;
+            else fprintf(stderr, "Fuente de energía '%s' no disponible; se usa otra\n", forzar);
+        }
+    }
+    if (energia_fuente < 0 && archivo_iniciar() == 0) energia_fuente = ENERGIA_ARCHIVO;
+    if (energia_fuente < 0 && rapl_iniciar() == 0) energia_fuente = ENERGIA_RAPL;
+    if (energia_fuente < 0 && modelo_iniciar() == 0) energia_fuente = ENERGIA_MODELO;
+    return energia_fuente;
+}
+
+// Joules acumulados de la fuente; 0 si no se inició (p. ej. en benchmark.c)
+double energia_leer() {
+    return energia_fuente >= 0 ? fuentes_energia[energia_fuente].leer() : 0;
+}
+
+// Energía de la corrida que aporta este proceso: con una fuente de nodo solo el líder,
+// para no sumar varias veces el mismo nodo
+double energia_corrida(double inicio, double fin) {
+    if (energia_fuente < 0) return 0;
+    if (fuentes_energia[energia_fuente].por_nodo && !energia_lider_nodo) return 0;
+    return fin - inicio;
+}
+
+#endif
@@ -0,0 +1,263 @@
+// escritura_async.h
+#ifndef ESCRITURA_ASYNC_H
+#define ESCRITURA_ASYNC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <omp.h>
+#include "bmp_io.h"
+#include "contenedor.h"
+
+// Etapa de escritura diferida: los filtros entregan sus salidas ya calculadas (archivos
+// mapeados) a una cola acotada que vacían hilos escritores dedicados. El escritor
+// desmapea, hace fsync y cierra; así los hilos de cómputo no esperan al disco.
+// Cuando la cola está llena, entregar una salida bloquea hasta que haya lugar.
+//
+// Cada imagen lleva un contador de salidas pendientes y se da por terminada (se llama
+// a su callback) solo cuando todas sus salidas quedaron escritas en disco. En ese
+// momento también se publican las copias pedidas con imagen_pendiente_publicar.
+
+#define ESCRITURA_MAX_COLA 32
+#define ESCRITURA_MAX_HILOS 8
+#define MAX_PUBLICAR 8
+
+typedef void (*imagen_lista_fn)(int indice, double segundos);
+
+typedef struct {
+    int indice;
+    int pendientes;
+    double t0;
+    imagen_lista_fn lista;
+    int n_publicar;
+    char* publicar_origen[MAX_PUBLICAR];
+    char* publicar_destino[MAX_PUBLICAR];
+    pthread_mutex_t mutex;
+} ImagenPendiente;
+
+typedef struct {
+    SalidaBMP salida;
+    ImagenPendiente* imagen;
+} TrabajoEscritura;
+
+typedef struct {
+    TrabajoEscritura trabajos[ESCRITURA_MAX_COLA];
+    int inicio;
+    int cantidad;
+    int terminar;
+    int n_hilos;
+    pthread_t hilos[ESCRITURA_MAX_HILOS];
+    pthread_mutex_t mutex;
+    pthread_cond_t hay_trabajo;
+    pthread_cond_t hay_lugar;
+} ColaEscritura;
+
+ColaEscritura cola_escritura;
+int escritura_activa = 0;
+int publicar_secuencia = 0;
+
+int copiar_archivo(const char* origen, const char* destino) {
+    int in = open(origen, O_RDONLY);
+    if (in < 0) return -1;
+    int out = open(destino, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+        close(in);
+        return -1;
+    }
+
+    char buf[1 << 16];
+    ssize_t n;
+    int error = 0;
+    while ((n = read(in, buf, sizeof(buf))) > 0) {
+        if (write(out, buf, n) != n) { error = 1; break; }
+    }
+    if (n < 0 || fsync(out) != 0) error = 1;
+    close(in);
+    close(out);
+    if (error) unlink(destino);
+    return error ? -1 : 0;
+}
+
+// Deja en `destino` el mismo contenido que `origen`: enlace duro si están en el mismo
+// sistema de archivos; si no, copia, o con `copiar` en 0 falla (errno de link). Se arma
+// con un nombre temporal y rename, así quien lea `destino` nunca ve un archivo a medias.
+int publicar_archivo(const char* origen, const char* destino, int copiar) {
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.tmp.%d.%d", destino, (int)getpid(),
+             __atomic_add_fetch(&publicar_secuencia, 1, __ATOMIC_RELAXED));
+
+    if (link(origen, tmp) != 0 && (!copiar || copiar_archivo(origen, tmp) != 0)) return -1;
+    if (rename(tmp, destino) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    // Si `destino` ya era un enlace al mismo archivo, rename no hace nada y deja `tmp`
+    unlink(tmp);
+    return 0;
+}
+
+// El contador arranca en 1: esa referencia la suelta quien encola las salidas,
+// para que la imagen no termine mientras todavía se están entregando.
+ImagenPendiente* imagen_pendiente_crear(int indice, imagen_lista_fn lista) {
+    ImagenPendiente* p = (ImagenPendiente*) malloc(sizeof(ImagenPendiente));
+    p->indice = indice;
+    p->pendientes = 1;
+    p->t0 = omp_get_wtime();
+    p->lista = lista;
+    p->n_publicar = 0;
+    pthread_mutex_init(&p->mutex, NULL);
+    return p;
+}
+
+// Pide que `origen` se enlace en `destino` cuando todas las salidas de la imagen estén
+// en disco (p. ej. para guardarla en la caché de resultados). Nunca se copia.
+void imagen_pendiente_publicar(ImagenPendiente* p, const char* origen, const char* destino) {
+    pthread_mutex_lock(&p->mutex);
+    if (p->n_publicar < MAX_PUBLICAR) {
+        p->publicar_origen[p->n_publicar] = strdup(origen);
+        p->publicar_destino[p->n_publicar] = strdup(destino);
+        p->n_publicar++;
+    }
+    pthread_mutex_unlock(&p->mutex);
+}
+
+void imagen_pendiente_retener(ImagenPendiente* p) {
+    pthread_mutex_lock(&p->mutex);
+    p->pendientes++;
+    pthread_mutex_unlock(&p->mutex);
+}
+
+void imagen_pendiente_soltar(ImagenPendiente* p) {
+    pthread_mutex_lock(&p->mutex);
+    int quedan = --p->pendientes;
+    pthread_mutex_unlock(&p->mutex);
+
+    if (quedan == 0) {
+        for (int i = 0; i < p->n_publicar; i++) {
+            publicar_archivo(p->publicar_origen[i], p->publicar_destino[i], 0);
+            free(p->publicar_origen[i]);
+            free(p->publicar_destino[i]);
+        }
+        if (p->lista) p->lista(p->indice, omp_get_wtime() - p->t0);
+        pthread_mutex_destroy(&p->mutex);
+        free(p);
+    }
+}
+
+// Cierra una salida mapeada dejándola en disco: desmapea, fsync y close. Una salida en
+// memoria se agrega al contenedor; su fsync se hace al cerrarlo (contenedor_finalizar).
+void escribir_salida_durable(SalidaBMP* salida) {
+    if (salida->nombre) {
+        contenedor_agregar(salida->nombre, salida->mapa, salida->tam_mapa);
+        cerrar_salida_bmp(salida);
+        return;
+    }
+    if (!salida->mapa) {
+        cerrar_salida_bmp(salida);
+        return;
+    }
+    munmap(salida->mapa, salida->tam_mapa);
+    if (fsync(salida->fd) != 0) perror("fsync de salida");
+    close(salida->fd);
+    salida->mapa = NULL;
+    salida->data = NULL;
+    salida->fd = -1;
+}
+
+void* hilo_escritor(void* arg) {
+    ColaEscritura* cola = (ColaEscritura*) arg;
+
+    while (1) {
+        pthread_mutex_lock(&cola->mutex);
+        while (cola->cantidad == 0 && !cola->terminar)
+            pthread_cond_wait(&cola->hay_trabajo, &cola->mutex);
+        if (cola->cantidad == 0 && cola->terminar) {
+            pthread_mutex_unlock(&cola->mutex);
+            return NULL;
+        }
+        TrabajoEscritura t = cola->trabajos[cola->inicio];
+        cola->inicio = (cola->inicio + 1) % ESCRITURA_MAX_COLA;
+        cola->cantidad--;
+        pthread_cond_signal(&cola->hay_lugar);
+        pthread_mutex_unlock(&cola->mutex);
+
+        escribir_salida_durable(&t.salida);
+        if (t.imagen) imagen_pendiente_soltar(t.imagen);
+    }
+}
+
+// hilos <= 0 toma FILTROS_HILOS_ESCRITURA o 2 por defecto.
+void escritura_iniciar(int hilos) {
+    if (hilos <= 0) {
+        const char* env = getenv("FILTROS_HILOS_ESCRITURA");
+        hilos = env ? atoi(env) : 2;
+    }
+    if (hilos < 1) hilos = 1;
+    if (hilos > ESCRITURA_MAX_HILOS) hilos = ESCRITURA_MAX_HILOS;
+
+    ColaEscritura* cola = &cola_escritura;
+    cola->inicio = 0;
+    cola->cantidad = 0;
+    cola->terminar = 0;
+    cola->n_hilos = hilos;
+    pthread_mutex_init(&cola->mutex, NULL);
+    pthread_cond_init(&cola->hay_trabajo, NULL);
+    pthread_cond_init(&cola->hay_lugar, NULL);
+
+    for (int i = 0; i < hilos; i++)
+        pthread_create(&cola->hilos[i], NULL, hilo_escritor, cola);
+    escritura_activa = 1;
+}
+
+// Entrega una salida terminada y la sigue a cuenta de `imagen`. Sin imagen o sin la
+// etapa activa se cierra en el momento como antes (sin fsync).
+void entregar_salida(SalidaBMP* salida, ImagenPendiente* imagen) {
+    if (!escritura_activa || !imagen || !salida->mapa) {
+        if (salida->nombre) escribir_salida_durable(salida);
+        else cerrar_salida_bmp(salida);
+        return;
+    }
+
+    imagen_pendiente_retener(imagen);
+
+    ColaEscritura* cola = &cola_escritura;
+    pthread_mutex_lock(&cola->mutex);
+    while (cola->cantidad == ESCRITURA_MAX_COLA)
+        pthread_cond_wait(&cola->hay_lugar, &cola->mutex);
+    int pos = (cola->inicio + cola->cantidad) % ESCRITURA_MAX_COLA;
+    cola->trabajos[pos].salida = *salida;
+    cola->trabajos[pos].imagen = imagen;
+    cola->cantidad++;
+    pthread_cond_signal(&cola->hay_trabajo);
+    pthread_mutex_unlock(&cola->mutex);
+
+    salida->mapa = NULL;
+    salida->data = NULL;
+    salida->fd = -1;
+    salida->nombre = NULL;
+}
+
+// Espera a que se escriba todo lo encolado y detiene los hilos escritores.
+void escritura_finalizar() {
+    if (!escritura_activa) return;
+
+    ColaEscritura* cola = &cola_escritura;
+    pthread_mutex_lock(&cola->mutex);
+    cola->terminar = 1;
+    pthread_cond_broadcast(&cola->hay_trabajo);
+    pthread_mutex_unlock(&cola->mutex);
+
+    for (int i = 0; i < cola->n_hilos; i++)
+        pthread_join(cola->hilos[i], NULL);
+
+    pthread_mutex_destroy(&cola->mutex);
+    pthread_cond_destroy(&cola->hay_trabajo);
+    pthread_cond_destroy(&cola->hay_lugar);
+    escritura_activa = 0;
+}
+
+#endif
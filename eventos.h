@@ -0,0 +1,284 @@
+// eventos.h
+#ifndef EVENTOS_H
+#define EVENTOS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <mpi.h>
+#include "contadores_hw.h"
+
+// Canal de progreso para la interfaz: un registro por salida generada (imagen, filtro,
+// proceso, duración, bytes) y uno por imagen terminada, en líneas JSON.
+//
+// Cada hilo anota sus eventos en un buffer circular propio sin locks (un productor, un
+// consumidor). Los buffers se vacían por lotes: en los trabajadores viajan al proceso 0
+// junto con el aviso de imagen terminada (reparto_mpi.h) y el proceso 0 los escribe en
+// el canal con un solo write por lote.
+//
+// FILTROS_EVENTOS=ruta abre el canal en el proceso 0: si la ruta es un socket Unix se
+// conecta a él; si no, se abre para agregar (archivo o FIFO). FILTROS_EVENTOS_FD=n usa
+// un descriptor heredado. Con el canal activo ya no se imprime una línea por salida.
+//
+// Si el buffer de un hilo se llena el evento se descarta y se cuenta: el progreso nunca
+// frena a los filtros. El registro "fin" informa cuántos se perdieron en el trabajo.
+
+#define EVENTOS_POR_HILO 4096
+
+typedef struct {
+    int indice;
+    int filtro;
+    int kernel;
+    int en_cache;
+    double segundos;
+    long long bytes;
+} EventoProgreso;
+
+typedef struct BufferEventos {
+    EventoProgreso eventos[EVENTOS_POR_HILO];
+    unsigned int escritos;      // solo lo avanza el hilo dueño
+    unsigned int leidos;        // solo lo avanza quien vacía, con eventos_consumo tomado
+    struct BufferEventos* siguiente;
+} BufferEventos;
+
+int eventos_activos = 0;
+int eventos_fd = -1;
+long long eventos_descartados = 0;
+BufferEventos* eventos_buffers = NULL;
+__thread BufferEventos* eventos_hilo = NULL;
+pthread_mutex_t eventos_consumo = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t eventos_salida = PTHREAD_MUTEX_INITIALIZER;
+
+int eventos_abrir_canal(const char* ruta) {
+    struct stat st;
+    if (stat(ruta, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        struct sockaddr_un dir;
+        memset(&dir, 0, sizeof(dir));
+        dir.sun_family = AF_UNIX;
+        snprintf(dir.sun_path, sizeof(dir.sun_path), "%s", ruta);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr*) &dir, sizeof(dir)) == 0) return fd;
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return open(ruta, O_WRONLY | O_CREAT | O_APPEND, 0644);
+}
+
+// Colectiva: el proceso 0 abre el canal y todos se enteran de si quedó activo. Si el
+// proceso 0 ya tiene canal (el cliente del modo servicio) se usa ese.
+void eventos_iniciar(int rank, MPI_Comm comm) {
+    if (rank == 0 && eventos_fd < 0) {
+        const char* ruta = getenv("FILTROS_EVENTOS");
+        const char* fd = getenv("FILTROS_EVENTOS_FD");
+        if (ruta && ruta[0]) eventos_fd = eventos_abrir_canal(ruta);
+        else if (fd && fd[0]) eventos_fd = atoi(fd);
+        if ((ruta && ruta[0]) || (fd && fd[0])) {
+            if (eventos_fd < 0 || fcntl(eventos_fd, F_GETFD) < 0) {
+                fprintf(stderr, "No se pudo abrir el canal de eventos: %s\n", ruta && ruta[0] ? ruta : fd);
+                eventos_fd = -1;
+            }
+        }
+    }
+    eventos_descartados = 0;
+    if (rank == 0) {
+        eventos_activos = eventos_fd >= 0;
+        // Si la interfaz cierra el socket, write devuelve error en lugar de matar el proceso
+        if (eventos_activos) signal(SIGPIPE, SIG_IGN);
+    }
+    MPI_Bcast(&eventos_activos, 1, MPI_INT, 0, comm);
+}
+
+BufferEventos* eventos_buffer_hilo() {
+    if (!eventos_hilo) {
+        BufferEventos* b = (BufferEventos*) calloc(1, sizeof(BufferEventos));
+        b->siguiente = __atomic_load_n(&eventos_buffers, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&eventos_buffers, &b->siguiente, b, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+        eventos_hilo = b;
+    }
+    return eventos_hilo;
+}
+
+// Anota un evento del hilo actual sin tomar locks. Si el buffer está lleno (cada imagen
+// terminada lo vacía, así que en la práctica no pasa) el evento se descarta.
+void eventos_registrar(int indice, int filtro, int kernel, int en_cache, double segundos, long long bytes) {
+    if (!eventos_activos) return;
+
+    BufferEventos* b = eventos_buffer_hilo();
+    unsigned int w = b->escritos;
+    if (w - __atomic_load_n(&b->leidos, __ATOMIC_ACQUIRE) == EVENTOS_POR_HILO) {
+        __atomic_add_fetch(&eventos_descartados, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    EventoProgreso* e = &b->eventos[w % EVENTOS_POR_HILO];
+    e->indice = indice;
+    e->filtro = filtro;
+    e->kernel = kernel;
+    e->en_cache = en_cache;
+    e->segundos = segundos;
+    e->bytes = bytes;
+    __atomic_store_n(&b->escritos, w + 1, __ATOMIC_RELEASE);
+}
+
+// Saca todos los eventos pendientes de todos los hilos. Devuelve un arreglo con
+// malloc (o NULL si no hay) y deja en *n cuántos son.
+EventoProgreso* eventos_recolectar(int* n) {
+    *n = 0;
+    if (!eventos_activos) return NULL;
+
+    pthread_mutex_lock(&eventos_consumo);
+    BufferEventos* lista = __atomic_load_n(&eventos_buffers, __ATOMIC_ACQUIRE);
+    int total = 0;
+    for (BufferEventos* b = lista; b; b = b->siguiente)
+        total += __atomic_load_n(&b->escritos, __ATOMIC_ACQUIRE) - b->leidos;
+
+    EventoProgreso* lote = NULL;
+    if (total > 0) {
+        lote = (EventoProgreso*) malloc(total * sizeof(EventoProgreso));
+        for (BufferEventos* b = lista; b && *n < total; b = b->siguiente) {
+            unsigned int w = __atomic_load_n(&b->escritos, __ATOMIC_ACQUIRE);
+            unsigned int r = b->leidos;
+            for (; r != w && *n < total; r++) lote[(*n)++] = b->eventos[r % EVENTOS_POR_HILO];
+            __atomic_store_n(&b->leidos, r, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&eventos_consumo);
+    return lote;
+}
+
+// Escribe el texto completo en el canal; un write por lote salvo escrituras parciales.
+void eventos_escribir(const char* texto, size_t largo) {
+    pthread_mutex_lock(&eventos_salida);
+    while (largo > 0 && eventos_fd >= 0) {
+        ssize_t w = write(eventos_fd, texto, largo);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) {
+            // La interfaz cerró el canal: se deja de emitir sin afectar el procesamiento
+            close(eventos_fd);
+            eventos_fd = -1;
+            break;
+        }
+        texto += w;
+        largo -= w;
+    }
+    pthread_mutex_unlock(&eventos_salida);
+}
+
+// Copia `texto` escapado para una cadena JSON (recortado a `tam` bytes)
+void eventos_escapar(char* dst, size_t tam, const char* texto) {
+    size_t j = 0;
+    for (; *texto && j + 7 < tam; texto++) {
+        unsigned char c = (unsigned char) *texto;
+        if (c == '"' || c == '\\') { dst[j++] = '\\'; dst[j++] = c; }
+        else if (c < 0x20) j += snprintf(dst + j, tam - j, "\\u%04x", c);
+        else dst[j++] = c;
+    }
+    dst[j] = '\0';
+}
+
+// Nombre de archivo sin directorio, escapado
+void eventos_nombre(char* dst, size_t tam, const char* ruta) {
+    const char* nombre = strrchr(ruta, '/');
+    eventos_escapar(dst, tam, nombre ? nombre + 1 : ruta);
+}
+
+// Solo en el proceso 0: emite un lote de eventos del proceso `origen`.
+void eventos_emitir(const EventoProgreso* lote, int n, int origen, char* const* nombres) {
+    if (n <= 0 || eventos_fd < 0) return;
+
+    size_t cap = (size_t)n * 512, largo = 0;
+    char* texto = (char*) malloc(cap);
+    char nombre[320];
+    for (int i = 0; i < n; i++) {
+        const EventoProgreso* e = &lote[i];
+        eventos_nombre(nombre, sizeof(nombre), nombres[e->indice]);
+        largo += snprintf(texto + largo, cap - largo,
+                          "{\"tipo\":\"salida\",\"imagen\":\"%s\",\"filtro\":\"%s\",\"kernel\":%d,\"proceso\":%d,"
+                          "\"cache\":%d,\"segundos\":%.6f,\"bytes\":%lld}\n",
+                          nombre, nombres_filtros[e->filtro], e->kernel, origen, e->en_cache, e->segundos, e->bytes);
+    }
+    eventos_escribir(texto, largo);
+    free(texto);
+}
+
+void eventos_imagen_terminada(const char* ruta, int proceso, double segundos) {
+    if (eventos_fd < 0) return;
+    char linea[512], nombre[320];
+    eventos_nombre(nombre, sizeof(nombre), ruta);
+    int largo = snprintf(linea, sizeof(linea), "{\"tipo\":\"imagen\",\"imagen\":\"%s\",\"proceso\":%d,\"segundos\":%.6f}\n",
+                         nombre, proceso, segundos);
+    eventos_escribir(linea, largo);
+}
+
+// Primer registro: cuántas salidas esperar en total, para un avance exacto
+void eventos_inicio(int imagenes, int salidas_por_imagen, int procesos) {
+    if (eventos_fd < 0) return;
+    char linea[256];
+    int largo = snprintf(linea, sizeof(linea), "{\"tipo\":\"inicio\",\"imagenes\":%d,\"salidas\":%lld,\"procesos\":%d}\n",
+                         imagenes, (long long)imagenes * salidas_por_imagen, procesos);
+    eventos_escribir(linea, largo);
+}
+
+void eventos_error(const char* mensaje) {
+    if (eventos_fd < 0) return;
+    char linea[512], texto[320];
+    eventos_escapar(texto, sizeof(texto), mensaje);
+    int largo = snprintf(linea, sizeof(linea), "{\"tipo\":\"error\",\"mensaje\":\"%s\"}\n", texto);
+    eventos_escribir(linea, largo);
+}
+
+// `descartados`: eventos de salida perdidos en todos los procesos por buffers llenos
+void eventos_fin(double segundos, long long descartados) {
+    if (eventos_fd < 0) return;
+    char linea[160];
+    int largo = snprintf(linea, sizeof(linea), "{\"tipo\":\"fin\",\"segundos\":%.6f,\"descartados\":%lld}\n",
+                         segundos, descartados);
+    eventos_escribir(linea, largo);
+}
+
+// Vacía los buffers del proceso 0 en el canal
+void eventos_vaciar_local(int rank, char* const* nombres) {
+    int n;
+    EventoProgreso* lote = eventos_recolectar(&n);
+    eventos_emitir(lote, n, rank, nombres);
+    free(lote);
+}
+
+// Usa `fd` como canal del próximo trabajo (el cliente del modo servicio)
+void eventos_usar_fd(int fd) {
+    pthread_mutex_lock(&eventos_salida);
+    eventos_fd = fd;
+    pthread_mutex_unlock(&eventos_salida);
+}
+
+// Cierra el canal del trabajo actual en cada proceso; los buffers de los hilos se conservan
+void eventos_cerrar_canal() {
+    pthread_mutex_lock(&eventos_salida);
+    if (eventos_fd > 2) close(eventos_fd);
+    eventos_fd = -1;
+    pthread_mutex_unlock(&eventos_salida);
+    eventos_activos = 0;
+}
+
+void eventos_finalizar() {
+    BufferEventos* b = eventos_buffers;
+    while (b) {
+        BufferEventos* sig = b->siguiente;
+        free(b);
+        b = sig;
+    }
+    eventos_buffers = NULL;
+    if (eventos_fd > 2) close(eventos_fd);
+    eventos_fd = -1;
+}
+
+#endif
@@ -0,0 +1,135 @@
+// extraer_contenedor.c
+// Lista y desempaqueta los contenedores de salidas (contenedor.h) que escribe cada
+// proceso con FILTROS_CONTENEDOR.
+//
+//   gcc -O2 extraer_contenedor.c -o extraer_contenedor -lpthread
+//   ./extraer_contenedor -l salidas_r0.fcn                 # lista las entradas
+//   ./extraer_contenedor salidas_r0.fcn                    # extrae todo a ./
+//   ./extraer_contenedor -d destino salidas_r0.fcn t0      # salidas y logs de la imagen t0
+//   ./extraer_contenedor salidas_r0.fcn t0 blur_105        # solo t0_blur_105.bmp
+//
+// Los nombres de las salidas son <imagen>_<filtro>.bmp y los logs logs/<imagen>_<tipo>.txt,
+// como sin contenedor. Cada entrada se lee directo de su offset en el índice. Si una
+// entrada aparece más de una vez (varias corridas sobre el mismo contenedor) vale la última.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "contenedor.h"
+
+// Sin imagen coincide todo; con imagen, sus salidas y sus logs; con filtro, solo esa salida
+int coincide(const char* nombre, const char* imagen, const char* filtro) {
+    if (!imagen) return 1;
+    const char* base = strncmp(nombre, "logs/", 5) == 0 ? nombre + 5 : nombre;
+    size_t largo = strlen(imagen);
+    if (strncmp(base, imagen, largo) != 0 || base[largo] != '_') return 0;
+    if (!filtro) return 1;
+    const char* resto = base + largo + 1;
+    size_t largo_filtro = strlen(filtro);
+    return strncmp(resto, filtro, largo_filtro) == 0 && resto[largo_filtro] == '.';
+}
+
+// Orden por nombre y, entre entradas del mismo nombre, la más nueva (mayor offset) primero
+int comparar_entradas(const void* a, const void* b) {
+    const EntradaContenedor* x = *(const EntradaContenedor* const*) a;
+    const EntradaContenedor* y = *(const EntradaContenedor* const*) b;
+    int c = strcmp(x->nombre, y->nombre);
+    if (c != 0) return c;
+    return x->offset < y->offset ? 1 : (x->offset > y->offset ? -1 : 0);
+}
+
+int extraer(int fd, const EntradaContenedor* e, const char* destino) {
+    char ruta[4096];
+    snprintf(ruta, sizeof(ruta), "%s/%s", destino, e->nombre);
+    char* barra = strrchr(ruta, '/');
+    if (barra && barra != ruta) {
+        *barra = '\0';
+        mkdir(ruta, 0755);
+        *barra = '/';
+    }
+
+    int out = open(ruta, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+        fprintf(stderr, "No se pudo crear %s\n", ruta);
+        return -1;
+    }
+    // Se copia por bloques para no cargar salidas grandes completas en memoria
+    size_t tam_bloque = 1 << 20;
+    unsigned char* bloque = (unsigned char*) malloc(tam_bloque);
+    int error = 0;
+    for (unsigned long long pos = 0; pos < e->largo && !error; pos += tam_bloque) {
+        size_t n = e->largo - pos < tam_bloque ? e->largo - pos : tam_bloque;
+        error = contenedor_leer_todo(fd, bloque, n, e->offset + pos) != 0 || write(out, bloque, n) != (ssize_t) n;
+    }
+    free(bloque);
+    close(out);
+    if (error) {
+        fprintf(stderr, "Error extrayendo %s\n", e->nombre);
+        unlink(ruta);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int listar = 0;
+    const char* destino = ".";
+    int opt;
+    while ((opt = getopt(argc, argv, "ld:")) != -1) {
+        if (opt == 'l') listar = 1;
+        else if (opt == 'd') destino = optarg;
+        else {
+            fprintf(stderr, "Uso: %s [-l] [-d destino] contenedor.fcn [imagen [filtro]]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Uso: %s [-l] [-d destino] contenedor.fcn [imagen [filtro]]\n", argv[0]);
+        return 2;
+    }
+    const char* archivo = argv[optind];
+    const char* imagen = optind + 1 < argc ? argv[optind + 1] : NULL;
+    const char* filtro = optind + 2 < argc ? argv[optind + 2] : NULL;
+
+    int fd = open(archivo, O_RDONLY);
+    if (fd < 0) {
+        perror(archivo);
+        return 1;
+    }
+    EntradaContenedor* entradas;
+    int n;
+    unsigned long long valido;
+    if (contenedor_leer_indice(fd, &entradas, &n, &valido) != 0) {
+        fprintf(stderr, "No se pudo leer el índice de %s\n", archivo);
+        close(fd);
+        return 1;
+    }
+
+    EntradaContenedor** orden = (EntradaContenedor**) malloc((n > 0 ? n : 1) * sizeof(EntradaContenedor*));
+    for (int i = 0; i < n; i++) orden[i] = &entradas[i];
+    qsort(orden, n, sizeof(EntradaContenedor*), comparar_entradas);
+
+    if (!listar) mkdir(destino, 0755);
+    int encontradas = 0, errores = 0;
+    for (int i = 0; i < n; i++) {
+        EntradaContenedor* e = orden[i];
+        if (i > 0 && strcmp(orden[i - 1]->nombre, e->nombre) == 0) continue;
+        if (!coincide(e->nombre, imagen, filtro)) continue;
+        encontradas++;
+        if (listar) printf("%12llu  %s\n", e->largo, e->nombre);
+        else errores += extraer(fd, e, destino) != 0;
+    }
+    free(orden);
+    if (!listar) printf("%d entradas extraídas en %s\n", encontradas - errores, destino);
+
+    contenedor_liberar_indice(entradas, n);
+    close(fd);
+    if (encontradas == 0) {
+        fprintf(stderr, "Ninguna entrada coincide\n");
+        return 1;
+    }
+    return errores ? 1 : 0;
+}
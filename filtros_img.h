@@ -6,357 +6,727 @@
 #include <stdlib.h>
 #include <string.h>
 #include <omp.h>
-
-void generar_log(const char* nombre, const char* tipo, long long lecturas, long long escrituras, double tiempo) {
-    char ruta[128];
-    sprintf(ruta, "./logs/%s_%s.txt", nombre, tipo);    
-    FILE* log = fopen(ruta, "w");
-
-    long long instrucciones = (lecturas + escrituras) * 20LL;
+#include "bmp_io.h"
+#include "escritura_async.h"
+#include "grises_simd.h"
+#include "contadores_hw.h"
+
+void generar_log(const char* nombre, const char* tipo, long long lecturas, long long escrituras, const MedicionHW* m) {
+    char ruta[512];
+    snprintf(ruta, sizeof(ruta), "./logs/%s_%s.txt", nombre, tipo);
+    // Con el contenedor de salidas activo el log va como una entrada más ("logs/...")
+    char* texto = NULL;
+    size_t largo = 0;
+    FILE* log = contenedor_activo ? open_memstream(&texto, &largo) : fopen(ruta, "w");
+    if (!log) return;
+
+    double tiempo = m->tiempo;
     if (tiempo <= 0.000001) {
         tiempo = 0.000001;
     }
-    double mips = instrucciones / (tiempo * 1e6);
-    long bytes_totales = lecturas + escrituras;
+    long long bytes_totales = lecturas + escrituras;
     double bytes_por_segundo = bytes_totales / tiempo;
 
-    fprintf(log, "Archivo: %s.bmp\nTipo: %s\nLecturas: %lld\nEscrituras: %lld\nTiempo: %lf\nMIPS: %lf\nBytes por segundo: %lf\n",
-        nombre, tipo, lecturas, escrituras, tiempo, mips, bytes_por_segundo);
+    fprintf(log, "Archivo: %s.bmp\nTipo: %s\nLecturas: %lld\nEscrituras: %lld\nTiempo: %lf\n",
+        nombre, tipo, lecturas, escrituras, tiempo);
 
-    fclose(log);
-}
+    if (m->total[HW_INSTRUCCIONES] >= 0) {
+        fprintf(log, "Instrucciones: %lld\nMIPS: %lf\n",
+            m->total[HW_INSTRUCCIONES], m->total[HW_INSTRUCCIONES] / (tiempo * 1e6));
+    } else {
+        fprintf(log, "Instrucciones: no disponible\nMIPS: no disponible\n");
+    }
+    if (m->total[HW_CICLOS] >= 0) fprintf(log, "Ciclos: %lld\n", m->total[HW_CICLOS]);
+    if (m->total[HW_FALLOS_CACHE] >= 0) fprintf(log, "Fallos de cache: %lld\n", m->total[HW_FALLOS_CACHE]);
+    fprintf(log, "Hilos: %d\nBytes por segundo: %lf\n", m->equipo ? m->hilos : 1, bytes_por_segundo);
 
-void to_grayscale(const char* in, const char* out, const char* nombre_base) {
-    FILE *f = fopen(in, "rb");
-    FILE *fo = fopen(out, "wb");
-
-    if (!f || !fo) {
-        fprintf(stderr, "Error al abrir archivos.\n");
-        return;
-    }
-
-    unsigned char header[54];
-    fread(header, sizeof(unsigned char), 54, f);
-    fwrite(header, sizeof(unsigned char), 54, fo);
-
-    int ancho = *(int*)&header[18];
-    int alto = *(int*)&header[22];
-    int row_padded = (ancho * 3 + 3) & (~3); // Asegura múltiplo de 4 bytes
-    int tam = row_padded * alto;
-
-    unsigned char* data = (unsigned char*) malloc(tam);
-    fread(data, tam, 1, f);
-
-    double t0 = omp_get_wtime();
-    int lecturas = 0, escrituras = 0;
-
-    for (int i = 0; i < tam; i += row_padded) {
-        for (int j = 0; j < ancho * 3; j += 3) {
-            unsigned char b = data[i + j];
-            unsigned char g = data[i + j + 1];
-            unsigned char r = data[i + j + 2];
-            unsigned char gray = 0.21*r + 0.72*g + 0.07*b;
-            data[i + j] = data[i + j + 1] = data[i + j + 2] = gray;
-            lecturas += 3;
-            escrituras += 3;
-        }
+    fclose(log);
+    if (texto) {
+        contenedor_agregar(ruta + 2, texto, largo);
+        free(texto);
     }
+}
 
-    double t1 = omp_get_wtime();
-    fwrite(data, tam, 1, fo);
+// Kernels sobre memoria: leen src y escriben dst (mismo tamaño con padding).
+// El padding de cada fila se copia sin tocar.
+//
+// Fuera de una región paralela y con imágenes de al menos PARALELO_MIN_PIXELES, cada
+// kernel reparte sus filas entre los hilos OpenMP. Dentro del bucle por imágenes de
+// main() siguen siendo secuenciales: ahí ya hay un hilo por imagen.
+#define PARALELO_MIN_PIXELES (1 << 18)
 
-    generar_log(nombre_base, "grises", lecturas, escrituras, t1 - t0);
-    fclose(f);
-    fclose(fo);
-    free(data);
+int paralelo_interno(int ancho, int alto) {
+    return (long long)ancho * alto >= PARALELO_MIN_PIXELES && !omp_in_parallel();
 }
 
-void mirror_horizontal_color(const char* in, const char* out, const char* nombre_base) {
-    FILE *f = fopen(in, "rb");
-    FILE *fo = fopen(out, "wb");
-
-    if (!f || !fo) {
-        fprintf(stderr, "Error al abrir archivos.\n");
-        return;
-    }
-
-    // Leer encabezado de archivo (14 bytes)
-    unsigned char file_header[14];
-    fread(file_header, 1, 14, f);
-
-    // Leer tamaño del DIB header (4 bytes)
-    int dib_header_size;
-    fread(&dib_header_size, 4, 1, f);
-
-    // Leer el resto del DIB header
-    unsigned char* dib_header = (unsigned char*) malloc(dib_header_size - 4);
-    fread(dib_header, 1, dib_header_size - 4, f);
-
-    // Ensamblar el encabezado completo para escribirlo igual al original
-    int header_total = 14 + dib_header_size;
-    unsigned char* full_header = (unsigned char*) malloc(header_total);
-    memcpy(full_header, file_header, 14);
-    memcpy(full_header + 14, &dib_header_size, 4);
-    memcpy(full_header + 18, dib_header, dib_header_size - 4);
-    fwrite(full_header, 1, header_total, fo);
-
-    // Obtener información crítica
-    int offset_pixels = *(int*)&file_header[10];
-    int ancho = *(int*)&full_header[18];
-    int alto = *(int*)&full_header[22];
-    short bpp = *(short*)&full_header[28];
-    int compression = *(int*)&full_header[30];
-
-    if (bpp != 24 || compression != 0) {
-        fprintf(stderr, "[ERROR] Solo se soportan BMPs de 24 bits sin compresión. bpp=%d, compression=%d\n", bpp, compression);
-        fclose(f); fclose(fo);
-        free(dib_header); free(full_header);
-        return;
-    }
-
-    fseek(f, offset_pixels, SEEK_SET);
-    fseek(fo, offset_pixels, SEEK_SET);
-
-    int row_padded = (ancho * 3 + 3) & (~3);
-    int tam = row_padded * alto;
-    unsigned char* data = (unsigned char*) malloc(tam);
-    fread(data, tam, 1, f);
-
-    double t0 = omp_get_wtime();
-    int lecturas = 0, escrituras = 0;
-
-    for (int i = 0; i < alto; i++) {
-        unsigned char* row = data + i * row_padded;
-        unsigned char* temp = (unsigned char*) malloc(row_padded);
-
-        // Espejo horizontal por fila
-        for (int j = 0; j < ancho; j++) {
-            int src = j * 3;
-            int dst = (ancho - 1 - j) * 3;
-            temp[dst] = row[src];
-            temp[dst + 1] = row[src + 1];
-            temp[dst + 2] = row[src + 2];
-            lecturas += 3;
-            escrituras += 3;
-        }
+void grises_buffer(const unsigned char* src, unsigned char* dst, int ancho, int alto, int row_padded) {
+    grises_fila_fn grises_fila = grises_seleccionar();
+
+    #pragma omp parallel for schedule(static) if(paralelo_interno(ancho, alto))
+    for (int y = 0; y < alto; y++) {
+        const unsigned char* row = src + (size_t)y * row_padded;
+        unsigned char* out = dst + (size_t)y * row_padded;
 
-        // Copiar padding sin tocar
-        memcpy(temp + ancho * 3, row + ancho * 3, row_padded - ancho * 3);
-        memcpy(row, temp, row_padded);
-        free(temp);
+        grises_fila(row, out, ancho);
+        memcpy(out + ancho * 3, row + ancho * 3, row_padded - ancho * 3);
     }
+}
 
-    double t1 = omp_get_wtime();
-    fwrite(data, tam, 1, fo);
+// Invierte el orden de los pixeles de una fila. Se recorre de cuatro en cuatro con
+// punteros que avanzan en sentidos opuestos, sin recalcular índices por byte.
+void espejo_fila_horizontal(const unsigned char* row, unsigned char* out, int ancho) {
+    const unsigned char* s = row;
+    unsigned char* d = out + (size_t)(ancho - 1) * 3;
+    int j = 0;
+
+    for (; j + 4 <= ancho; j += 4, s += 12, d -= 12) {
+        d[0] = s[0];  d[1] = s[1];   d[2] = s[2];
+        d[-3] = s[3]; d[-2] = s[4];  d[-1] = s[5];
+        d[-6] = s[6]; d[-5] = s[7];  d[-4] = s[8];
+        d[-9] = s[9]; d[-8] = s[10]; d[-7] = s[11];
+    }
+    for (; j < ancho; j++, s += 3, d -= 3) {
+        d[0] = s[0]; d[1] = s[1]; d[2] = s[2];
+    }
+}
 
-    generar_log(nombre_base, "espejo_horizontal_color", lecturas, escrituras, t1 - t0);
+void espejo_horizontal_buffer(const unsigned char* src, unsigned char* dst, int ancho, int alto, int row_padded) {
+    #pragma omp parallel for schedule(static) if(paralelo_interno(ancho, alto))
+    for (int y = 0; y < alto; y++) {
+        const unsigned char* row = src + (size_t)y * row_padded;
+        unsigned char* out = dst + (size_t)y * row_padded;
 
-    fclose(f);
-    fclose(fo);
-    free(data);
-    free(dib_header);
-    free(full_header);
+        espejo_fila_horizontal(row, out, ancho);
+        memcpy(out + ancho * 3, row + ancho * 3, row_padded - ancho * 3);
+    }
 }
 
-void mirror_vertical_color(const char* in, const char* out, const char* nombre_base) {
-    FILE *f = fopen(in, "rb");
-    FILE *fo = fopen(out, "wb");
-
-    if (!f || !fo) {
-        fprintf(stderr, "Error al abrir archivos.\n");
-        return;
+void espejo_vertical_buffer(const unsigned char* src, unsigned char* dst, int alto, int row_padded) {
+    #pragma omp parallel for schedule(static) if(paralelo_interno(row_padded / 3, alto))
+    for (int y = 0; y < alto; y++) {
+        memcpy(dst + (size_t)y * row_padded, src + (size_t)(alto - 1 - y) * row_padded, row_padded);
     }
+}
 
-    // Leer encabezado de archivo (14 bytes)
-    unsigned char file_header[14];
-    fread(file_header, 1, 14, f);
+// Espejo de una fila de un byte por pixel (grises de 8 bits)
+void espejo_fila_horizontal8(const unsigned char* row, unsigned char* out, int ancho) {
+    for (int j = 0; j < ancho; j++) out[ancho - 1 - j] = row[j];
+}
 
-    // Leer tamaño del DIB header
-    int dib_header_size;
-    fread(&dib_header_size, 4, 1, f);
+// Grises y los cuatro espejos en un solo recorrido de src: cada fila de entrada se lee
+// una vez y de ella salen la fila gris, sus espejos y los espejos a color. Los espejos
+// grises se arman desde la fila gris recién calculada (todavía en caché), sin volver a
+// recorrer la imagen. Cualquier salida puede ser NULL; si gris es NULL pero se pide
+// algún espejo gris, la fila gris va a un buffer de una fila por hilo.
+// Con gris_8bits las tres salidas grises son de un byte por pixel con filas de
+// fila_gris8(ancho) bytes y padding en cero; si no, son BGR como la entrada.
+// El resultado es idéntico al de grises_buffer + espejo_*_buffer.
+void grises_espejos_buffer(const unsigned char* src, unsigned char* gris, unsigned char* gris_h, unsigned char* gris_v,
+                           unsigned char* color_h, unsigned char* color_v, int ancho, int alto, int row_padded,
+                           int gris_8bits) {
+    grises_fila_fn grises_fila = gris_8bits ? grises8_seleccionar() : grises_seleccionar();
+    int n = ancho * 3;
+    int con_gris = gris || gris_h || gris_v;
+    int fila_g = gris_8bits ? fila_gris8(ancho) : row_padded;
+    int n_g = gris_8bits ? ancho : n;
+
+    #pragma omp parallel if(paralelo_interno(ancho, alto))
+    {
+        unsigned char* fila_gris = con_gris && !gris ? (unsigned char*) pool_tomar(fila_g) : NULL;
+
+        #pragma omp for schedule(static)
+        for (int y = 0; y < alto; y++) {
+            const unsigned char* row = src + (size_t)y * row_padded;
+            size_t fila = (size_t)y * row_padded;
+            size_t fila_espejo = (size_t)(alto - 1 - y) * row_padded;
+
+            if (color_h) {
+                espejo_fila_horizontal(row, color_h + fila, ancho);
+                memcpy(color_h + fila + n, row + n, row_padded - n);
+            }
+            if (color_v) memcpy(color_v + fila_espejo, row, row_padded);
 
-    // Leer el resto del DIB header
-    unsigned char* dib_header = (unsigned char*) malloc(dib_header_size - 4);
-    fread(dib_header, 1, dib_header_size - 4, f);
+            if (con_gris) {
+                size_t fila8 = (size_t)y * fila_g;
+                size_t fila8_espejo = (size_t)(alto - 1 - y) * fila_g;
+                unsigned char* g = gris ? gris + fila8 : fila_gris;
 
-    // Combinar encabezado completo
-    int header_total = 14 + dib_header_size;
-    unsigned char* full_header = (unsigned char*) malloc(header_total);
-    memcpy(full_header, file_header, 14);
-    memcpy(full_header + 14, &dib_header_size, 4);
-    memcpy(full_header + 18, dib_header, dib_header_size - 4);
-    fwrite(full_header, 1, header_total, fo);
+                grises_fila(row, g, ancho);
+                if (gris_8bits) memset(g + n_g, 0, fila_g - n_g);
+                else memcpy(g + n_g, row + n_g, fila_g - n_g);
 
-    // Obtener metadatos críticos
-    int offset_pixels = *(int*)&file_header[10];
-    int ancho = *(int*)&full_header[18];
-    int alto = *(int*)&full_header[22];
-    short bpp = *(short*)&full_header[28];
-    int compression = *(int*)&full_header[30];
+                if (gris_h) {
+                    if (gris_8bits) espejo_fila_horizontal8(g, gris_h + fila8, ancho);
+                    else espejo_fila_horizontal(g, gris_h + fila8, ancho);
+                    memcpy(gris_h + fila8 + n_g, g + n_g, fila_g - n_g);
+                }
+                if (gris_v) memcpy(gris_v + fila8_espejo, g, fila_g);
+            }
+        }
 
-    if (bpp != 24 || compression != 0) {
-        fprintf(stderr, "[ERROR] Solo BMPs de 24 bits sin compresión son compatibles. bpp=%d, compression=%d\n", bpp, compression);
-        fclose(f); fclose(fo);
-        free(dib_header); free(full_header);
-        return;
+        pool_devolver(fila_gris);
     }
+}
 
-    fseek(f, offset_pixels, SEEK_SET);
-    fseek(fo, offset_pixels, SEEK_SET);
+// Divisor exacto por multiplicación: para sumas de hasta 255*d con d <= BLUR_MAX_COUNT,
+// (suma * inv[d]) >> BLUR_SHIFT da el mismo resultado que suma / d.
+#define BLUR_SHIFT 40
+#define BLUR_MAX_COUNT 65535
+#define MAX_KERNELS_BLUR 16     // kernels por corrida en el modo de barrido
+
+unsigned long long* blur_reciprocos(int max_count) {
+    unsigned long long* inv = (unsigned long long*) pool_tomar((max_count + 1) * sizeof(unsigned long long));
+    inv[0] = 0;
+    for (int d = 1; d <= max_count; d++) {
+        inv[d] = ((1ULL << BLUR_SHIFT) / d) + 1;
+    }
+    return inv;
+}
 
-    int row_padded = (ancho * 3 + 3) & (~3);
-    int tam = row_padded * alto;
+// Blur horizontal de una fila BGR con suma deslizante: entra un pixel y sale otro,
+// así el costo por pixel no depende de k. En los bordes se divide entre los pixeles válidos.
+void blur_fila_horizontal(const unsigned char* src, unsigned char* dst, int width, int k, const unsigned long long* inv) {
+    unsigned int sumB = 0, sumG = 0, sumR = 0;
+    int fin = k < width - 1 ? k : width - 1;
 
-    // Leer toda la imagen en memoria (con padding)
-    unsigned char* data = (unsigned char*) malloc(tam);
-    fread(data, 1, tam, f);
+    for (int x = 0; x <= fin; x++) {
+        sumB += src[x * 3 + 0];
+        sumG += src[x * 3 + 1];
+        sumR += src[x * 3 + 2];
+    }
 
-    double t0 = omp_get_wtime();
-    int lecturas = tam;
-    int escrituras = tam;
+    int x = 0;
+
+    // Borde izquierdo: la ventana todavía no está completa
+    for (; x < width && x < k; x++) {
+        int der = x + k < width - 1 ? x + k : width - 1;
+        unsigned long long m = inv[der + 1];
+        dst[x * 3 + 0] = (unsigned char)((sumB * m) >> BLUR_SHIFT);
+        dst[x * 3 + 1] = (unsigned char)((sumG * m) >> BLUR_SHIFT);
+        dst[x * 3 + 2] = (unsigned char)((sumR * m) >> BLUR_SHIFT);
+        if (x + k + 1 < width) {
+            int in = (x + k + 1) * 3;
+            sumB += src[in + 0]; sumG += src[in + 1]; sumR += src[in + 2];
+        }
+    }
 
-    // Escribir las filas en orden invertido
-    for (int y = alto - 1; y >= 0; y--) {
-        fwrite(data + y * row_padded, 1, row_padded, fo);
+    // Interior: ventana completa de 2k+1 pixeles, recíproco constante
+    unsigned long long m = inv[2 * k + 1 < width ? 2 * k + 1 : width];
+    for (; x + k + 1 < width; x++) {
+        int in = (x + k + 1) * 3;
+        int out = (x - k) * 3;
+        dst[x * 3 + 0] = (unsigned char)((sumB * m) >> BLUR_SHIFT);
+        dst[x * 3 + 1] = (unsigned char)((sumG * m) >> BLUR_SHIFT);
+        dst[x * 3 + 2] = (unsigned char)((sumR * m) >> BLUR_SHIFT);
+        sumB += src[in + 0] - src[out + 0];
+        sumG += src[in + 1] - src[out + 1];
+        sumR += src[in + 2] - src[out + 2];
     }
 
-    double t1 = omp_get_wtime();
-    generar_log(nombre_base, "espejo_vertical_color", lecturas, escrituras, t1 - t0);
+    // Borde derecho: la ventana se va vaciando
+    for (; x < width; x++) {
+        int izq = x - k > 0 ? x - k : 0;
+        unsigned long long m_borde = inv[width - izq];
+        dst[x * 3 + 0] = (unsigned char)((sumB * m_borde) >> BLUR_SHIFT);
+        dst[x * 3 + 1] = (unsigned char)((sumG * m_borde) >> BLUR_SHIFT);
+        dst[x * 3 + 2] = (unsigned char)((sumR * m_borde) >> BLUR_SHIFT);
+        if (x - k >= 0) {
+            int out = (x - k) * 3;
+            sumB -= src[out + 0]; sumG -= src[out + 1]; sumR -= src[out + 2];
+        }
+    }
+}
+
+// Ancho en bytes de cada franja de columnas del blur vertical: los acumuladores de la
+// franja (BLUR_FRANJA enteros) caben en L1 y cada fila se lee como un bloque contiguo.
+#define BLUR_FRANJA 1536
+
+// Blur vertical de las filas [y0, y1) de una franja de n bytes con un acumulador por
+// columna: por cada fila de salida se suma la fila que entra a la ventana y se resta la
+// que sale. El acumulador arranca con la ventana de y0, así las bandas son independientes.
+void blur_franja_vertical(const unsigned char* src, unsigned char* dst, int n, int height, int stride,
+                          int y0, int y1, int k, const unsigned long long* inv, unsigned int* acc) {
+    int ini = y0 - k > 0 ? y0 - k : 0;
+    int fin = y0 + k < height - 1 ? y0 + k : height - 1;
+
+    memset(acc, 0, n * sizeof(unsigned int));
+    for (int y = ini; y <= fin; y++) {
+        const unsigned char* fila = src + (size_t)y * stride;
+        for (int i = 0; i < n; i++) acc[i] += fila[i];
+    }
+
+    for (int y = y0; y < y1; y++) {
+        int izq = y - k > 0 ? y - k : 0;
+        int der = y + k < height - 1 ? y + k : height - 1;
+        unsigned long long m = inv[der - izq + 1];
+
+        unsigned char* fila = dst + (size_t)y * stride;
+        for (int i = 0; i < n; i++) {
+            fila[i] = (unsigned char)((acc[i] * m) >> BLUR_SHIFT);
+        }
 
-    fclose(f);
-    fclose(fo);
-    free(data);
-    free(dib_header);
-    free(full_header);
+        if (y + k + 1 < height && y - k >= 0) {
+            const unsigned char* entra = src + (size_t)(y + k + 1) * stride;
+            const unsigned char* sale = src + (size_t)(y - k) * stride;
+            for (int i = 0; i < n; i++) acc[i] += entra[i] - sale[i];
+        } else if (y + k + 1 < height) {
+            const unsigned char* entra = src + (size_t)(y + k + 1) * stride;
+            for (int i = 0; i < n; i++) acc[i] += entra[i];
+        } else if (y - k >= 0) {
+            const unsigned char* sale = src + (size_t)(y - k) * stride;
+            for (int i = 0; i < n; i++) acc[i] -= sale[i];
+        }
+    }
 }
 
-void mirror_horizontal_gray(const char* in, const char* out, const char* nombre_base) {
-    char temp_path[100];
-    sprintf(temp_path, "temp_%s.bmp", nombre_base);
+// Blur por streaming: recorre la imagen fila por fila y guarda solo una ventana
+// circular de 2k+1 filas ya difuminadas en horizontal más un acumulador por columna.
+// Cada fila de salida se escribe en cuanto su ventana está completa, así la memoria de
+// trabajo depende de ancho × kernel y no del alto. Da exactamente lo mismo que la
+// versión por franjas (mismas sumas, mismos recíprocos).
+//
+// Procesa las filas [y0, y1); la ventana arranca en y0 - k, así las bandas son independientes.
+void blur_banda_streaming(const unsigned char* src, unsigned char* dst, int width, int height, int row_padded,
+                          int y0, int y1, int k, const unsigned long long* inv,
+                          unsigned char* ventana, int filas_ventana, unsigned int* acc) {
+    int n = width * 3;
+    int ini = y0 - k > 0 ? y0 - k : 0;
+    int fin = y0 + k < height - 1 ? y0 + k : height - 1;
+
+    memset(acc, 0, n * sizeof(unsigned int));
+    for (int y = ini; y <= fin; y++) {
+        unsigned char* fila = ventana + (size_t)(y % filas_ventana) * n;
+        blur_fila_horizontal(src + (size_t)y * row_padded, fila, width, k, inv);
+        for (int i = 0; i < n; i++) acc[i] += fila[i];
+    }
+
+    for (int y = y0; y < y1; y++) {
+        int izq = y - k > 0 ? y - k : 0;
+        int der = y + k < height - 1 ? y + k : height - 1;
+        unsigned long long m = inv[der - izq + 1];
+
+        unsigned char* out = dst + (size_t)y * row_padded;
+        for (int i = 0; i < n; i++) {
+            out[i] = (unsigned char)((acc[i] * m) >> BLUR_SHIFT);
+        }
+        memcpy(out + n, src + (size_t)y * row_padded + n, row_padded - n);
 
-    to_grayscale(in, temp_path, nombre_base);
-    mirror_horizontal_color(temp_path, out, nombre_base);
-    remove(temp_path);
+        // La fila que sale ocupa la misma posición de la ventana que la que entra
+        if (y - k >= 0) {
+            const unsigned char* sale = ventana + (size_t)((y - k) % filas_ventana) * n;
+            for (int i = 0; i < n; i++) acc[i] -= sale[i];
+        }
+        if (y + k + 1 < height) {
+            unsigned char* entra = ventana + (size_t)((y + k + 1) % filas_ventana) * n;
+            blur_fila_horizontal(src + (size_t)(y + k + 1) * row_padded, entra, width, k, inv);
+            for (int i = 0; i < n; i++) acc[i] += entra[i];
+        }
+    }
 }
 
-void mirror_vertical_gray(const char* in, const char* out, const char* nombre_base) {
-    char temp_path[100];
-    sprintf(temp_path, "temp_%s.bmp", nombre_base);
+// Imágenes cuyo buffer temporal completo superaría este tamaño se difuminan por
+// streaming. FILTROS_BLUR_STREAMING=1 lo fuerza siempre y =0 lo desactiva.
+#define BLUR_STREAMING_MIN_BYTES ((size_t)64 << 20)
 
-    to_grayscale(in, temp_path, nombre_base);
-    mirror_vertical_color(temp_path, out, nombre_base);
-    remove(temp_path);
+int blur_usar_streaming(int row_padded, int height) {
+    const char* env = getenv("FILTROS_BLUR_STREAMING");
+    if (env && strcmp(env, "1") == 0) return 1;
+    if (env && strcmp(env, "0") == 0) return 0;
+    return (size_t)row_padded * height > BLUR_STREAMING_MIN_BYTES;
 }
 
-void apply_blur(const char* in, const char* out, const char* nombre_base, int kernel_size) {
-    FILE *image, *outputImage;
-    image = fopen(in, "rb");
-    outputImage = fopen(out, "wb");
+// En paralelo cada hilo recorre una banda de filas con su propia ventana; cada banda
+// vuelve a difuminar las 2k filas de su borde, por eso no bajan de 4 ventanas de alto.
+void blur_streaming(const unsigned char* src, unsigned char* dst, int width, int height, int row_padded,
+                    int k, const unsigned long long* inv) {
+    int n = width * 3;
+    int filas_ventana = 2 * k + 1 < height ? 2 * k + 1 : height;
+    int paralelo = paralelo_interno(width, height);
+    int bandas = 1;
+    if (paralelo) {
+        bandas = omp_get_max_threads();
+        int max_bandas = height / (4 * (2 * k + 1));
+        if (bandas > max_bandas) bandas = max_bandas;
+        if (bandas < 1) bandas = 1;
+    }
 
-    if (!image || !outputImage) {
-        printf("Error abriendo archivo.\n");
-        return;
+    #pragma omp parallel for schedule(static) if(paralelo && bandas > 1)
+    for (int b = 0; b < bandas; b++) {
+        unsigned char* ventana = (unsigned char*) pool_tomar((size_t)filas_ventana * n);
+        unsigned int* acc = (unsigned int*) pool_tomar((size_t)n * sizeof(unsigned int));
+        int y0 = (int)((long long)height * b / bandas);
+        int y1 = (int)((long long)height * (b + 1) / bandas);
+        blur_banda_streaming(src, dst, width, height, row_padded, y0, y1, k, inv, ventana, filas_ventana, acc);
+        pool_devolver(acc);
+        pool_devolver(ventana);
     }
+}
 
-    double t0 = omp_get_wtime();
+// Pasada vertical sobre el resultado horizontal `temp`, por franjas y bandas. Cada banda
+// recalcula su ventana inicial (2k+1 filas), por eso las bandas no bajan de 4 ventanas
+// de alto. Copia también el padding de cada fila.
+void blur_vertical(const unsigned char* temp, unsigned char* dst, int width, int height, int row_padded,
+                   int k, const unsigned long long* inv) {
+    int n = width * 3;
+    int paralelo = paralelo_interno(width, height);
+    int franjas = (n + BLUR_FRANJA - 1) / BLUR_FRANJA;
+    int bandas = 1;
+    if (paralelo) {
+        bandas = (2 * omp_get_max_threads() + franjas - 1) / franjas;
+        int max_bandas = height / (4 * (2 * k + 1));
+        if (bandas > max_bandas) bandas = max_bandas;
+        if (bandas < 1) bandas = 1;
+    }
 
-    unsigned char header[54];
-    fread(header, sizeof(unsigned char), 54, image);
-    fwrite(header, sizeof(unsigned char), 54, outputImage);
+    #pragma omp parallel for collapse(2) schedule(dynamic) if(paralelo)
+    for (int f = 0; f < franjas; f++) {
+        for (int b = 0; b < bandas; b++) {
+            unsigned int acc[BLUR_FRANJA];
+            int x0 = f * BLUR_FRANJA;
+            int ancho_franja = n - x0 < BLUR_FRANJA ? n - x0 : BLUR_FRANJA;
+            int y0 = (int)((long long)height * b / bandas);
+            int y1 = (int)((long long)height * (b + 1) / bandas);
+            blur_franja_vertical(temp + x0, dst + x0, ancho_franja, height, row_padded, y0, y1, k, inv, acc);
+        }
+    }
 
-    int width = *(int*)&header[18];
-    int height = *(int*)&header[22];
-    int row_padded = (width * 3 + 3) & (~3);
+    for (int y = 0; y < height; y++) {
+        memcpy(dst + (size_t)y * row_padded + n, temp + (size_t)y * row_padded + n, row_padded - n);
+    }
+}
 
-    unsigned char** input_rows = (unsigned char**)malloc(height * sizeof(unsigned char*));
-    unsigned char** output_rows = (unsigned char**)malloc(height * sizeof(unsigned char*));
+// Blur sobre un buffer contiguo con filas de row_padded bytes. La pasada horizontal
+// recorre fila por fila; la vertical procesa franjas de columnas para que tanto la
+// lectura como los acumuladores se mantengan en caché. En paralelo, la vertical se
+// divide además en bandas de filas para tener suficientes bloques por hilo.
+// Las imágenes grandes (ver blur_usar_streaming) van por blur_streaming sin temporal completo.
+int blur_buffer(const unsigned char* src, unsigned char* dst, int width, int height, int row_padded, int kernel_size) {
+    int k = kernel_size / 2;
+    int max_count = 2 * k + 1;
+    int max_dim = width > height ? width : height;
+    if (max_count > max_dim) max_count = max_dim;
 
-    int localidades_leidas = 54;
-    int localidades_escritas = 54;
+    if (max_count > BLUR_MAX_COUNT) {
+        fprintf(stderr, "[ERROR] Kernel de blur demasiado grande: %d\n", kernel_size);
+        return -1;
+    }
 
-    for (int i = 0; i < height; i++) {
-        input_rows[i] = (unsigned char*)malloc(row_padded);
-        output_rows[i] = (unsigned char*)malloc(row_padded);
-        fread(input_rows[i], sizeof(unsigned char), row_padded, image);
-        localidades_leidas += row_padded;
+    if (blur_usar_streaming(row_padded, height)) {
+        unsigned long long* inv = blur_reciprocos(max_count);
+        blur_streaming(src, dst, width, height, row_padded, k, inv);
+        pool_devolver(inv);
+        return 0;
     }
 
-    int k = kernel_size / 2;
+    int n = width * 3;
+    int paralelo = paralelo_interno(width, height);
+    unsigned long long* inv = blur_reciprocos(max_count);
+    unsigned char* temp = (unsigned char*) pool_tomar((size_t)row_padded * height);
 
     // Blur horizontal
-    unsigned char** temp_rows = (unsigned char**)malloc(height * sizeof(unsigned char*));
+    #pragma omp parallel for schedule(static) if(paralelo)
     for (int y = 0; y < height; y++) {
-        temp_rows[y] = (unsigned char*)malloc(row_padded);
-        for (int x = 0; x < width; x++) {
-            int sumB = 0, sumG = 0, sumR = 0, count = 0;
-
-            for (int dx = -k; dx <= k; dx++) {
-                int nx = x + dx;
-                if (nx >= 0 && nx < width) {
-                    int idx = nx * 3;
-                    sumB += input_rows[y][idx + 0];
-                    sumG += input_rows[y][idx + 1];
-                    sumR += input_rows[y][idx + 2];
-                    count++;
-                }
-            }
+        const unsigned char* row = src + (size_t)y * row_padded;
+        unsigned char* out = temp + (size_t)y * row_padded;
+        blur_fila_horizontal(row, out, width, k, inv);
+        memcpy(out + n, row + n, row_padded - n);
+    }
+
+    blur_vertical(temp, dst, width, height, row_padded, k, inv);
+
+    pool_devolver(inv);
+    pool_devolver(temp);
+    return 0;
+}
+
+// Blur horizontal de una fila a partir de sus sumas prefijo por canal (pref[3x + c] es la
+// suma de los x primeros pixeles del canal c): cada muestra son dos lecturas y una
+// resta sin importar k, y las sumas son exactamente las de la ventana deslizante.
+void blur_fila_prefijo_pixel(const unsigned int* pref, unsigned char* dst, int x, int width, int k,
+                             const unsigned long long* inv) {
+    int izq = x - k > 0 ? x - k : 0;
+    int der = x + k + 1 < width ? x + k + 1 : width;
+    unsigned long long m = inv[der - izq];
+    const unsigned int* a = pref + izq * 3;
+    const unsigned int* b = pref + der * 3;
+    dst[x * 3 + 0] = (unsigned char)(((unsigned long long)(b[0] - a[0]) * m) >> BLUR_SHIFT);
+    dst[x * 3 + 1] = (unsigned char)(((unsigned long long)(b[1] - a[1]) * m) >> BLUR_SHIFT);
+    dst[x * 3 + 2] = (unsigned char)(((unsigned long long)(b[2] - a[2]) * m) >> BLUR_SHIFT);
+}
+
+void blur_fila_prefijo(const unsigned int* pref, unsigned char* dst, int width, int k, const unsigned long long* inv) {
+    int x = 0;
+    int fin_izq = k < width ? k : width;
+    for (; x < fin_izq; x++) blur_fila_prefijo_pixel(pref, dst, x, width, k, inv);
+
+    // Interior: ventana completa, divisor fijo
+    unsigned long long m = inv[2 * k + 1 <= width ? 2 * k + 1 : width];
+    const unsigned int* a = pref;
+    const unsigned int* b = pref + (2 * k + 1) * 3;
+    for (; x + k + 1 <= width; x++, a += 3, b += 3) {
+        dst[x * 3 + 0] = (unsigned char)(((unsigned long long)(b[0] - a[0]) * m) >> BLUR_SHIFT);
+        dst[x * 3 + 1] = (unsigned char)(((unsigned long long)(b[1] - a[1]) * m) >> BLUR_SHIFT);
+        dst[x * 3 + 2] = (unsigned char)(((unsigned long long)(b[2] - a[2]) * m) >> BLUR_SHIFT);
+    }
+
+    for (; x < width; x++) blur_fila_prefijo_pixel(pref, dst, x, width, k, inv);
+}
 
-            int index = x * 3;
-            temp_rows[y][index + 0] = sumB / count;
-            temp_rows[y][index + 1] = sumG / count;
-            temp_rows[y][index + 2] = sumR / count;
+// Blur con varios kernels sobre la misma imagen (dst[i] recibe el kernel kernels[i]).
+// Las sumas prefijo de cada fila se calculan una vez y sirven para la pasada horizontal
+// de todos los kernels; la vertical es la de blur_buffer. El resultado de cada kernel es
+// idéntico al de blur_buffer. Con un solo kernel, o si la tabla no entra en el límite
+// del streaming, se corre blur_buffer por kernel.
+int blur_multi_buffer(const unsigned char* src, unsigned char* const* dst, int width, int height, int row_padded,
+                      const int* kernels, int n_kernels) {
+    int max_dim = width > height ? width : height;
+    int max_count = 1;
+    for (int i = 0; i < n_kernels; i++) {
+        int count = 2 * (kernels[i] / 2) + 1;
+        if (count > max_dim) count = max_dim;
+        if (count > BLUR_MAX_COUNT) {
+            fprintf(stderr, "[ERROR] Kernel de blur demasiado grande: %d\n", kernels[i]);
+            return -1;
         }
+        if (count > max_count) max_count = count;
+    }
 
-        for (int p = width * 3; p < row_padded; p++) {
-            temp_rows[y][p] = input_rows[y][p];
+    int n = width * 3;
+    size_t tam_prefijos = (size_t)(n + 3) * height * sizeof(unsigned int);
+    if (n_kernels == 1 || blur_usar_streaming(row_padded, height) || tam_prefijos > BLUR_STREAMING_MIN_BYTES) {
+        for (int i = 0; i < n_kernels; i++) {
+            if (blur_buffer(src, dst[i], width, height, row_padded, kernels[i]) != 0) return -1;
         }
+        return 0;
     }
 
-    // Blur vertical
+    int paralelo = paralelo_interno(width, height);
+    unsigned long long* inv = blur_reciprocos(max_count);
+    unsigned int* prefijos = (unsigned int*) pool_tomar(tam_prefijos);
+    unsigned char* temp = (unsigned char*) pool_tomar((size_t)row_padded * height);
+
+    // Las sumas de una fila caben en 32 bits: ancho <= 2^24 y cada canal <= 255
+    #pragma omp parallel for schedule(static) if(paralelo)
     for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            int sumB = 0, sumG = 0, sumR = 0, count = 0;
-
-            for (int dy = -k; dy <= k; dy++) {
-                int ny = y + dy;
-                if (ny >= 0 && ny < height) {
-                    int idx = x * 3;
-                    sumB += temp_rows[ny][idx + 0];
-                    sumG += temp_rows[ny][idx + 1];
-                    sumR += temp_rows[ny][idx + 2];
-                    count++;
-                }
-            }
+        const unsigned char* row = src + (size_t)y * row_padded;
+        unsigned int* pref = prefijos + (size_t)y * (n + 3);
+        pref[0] = pref[1] = pref[2] = 0;
+        for (int i = 0; i < n; i++) pref[i + 3] = pref[i] + row[i];
+    }
 
-            int index = x * 3;
-            output_rows[y][index + 0] = sumB / count;
-            output_rows[y][index + 1] = sumG / count;
-            output_rows[y][index + 2] = sumR / count;
+    for (int i = 0; i < n_kernels; i++) {
+        int k = kernels[i] / 2;
+
+        #pragma omp parallel for schedule(static) if(paralelo)
+        for (int y = 0; y < height; y++) {
+            const unsigned char* row = src + (size_t)y * row_padded;
+            unsigned char* out = temp + (size_t)y * row_padded;
+            blur_fila_prefijo(prefijos + (size_t)y * (n + 3), out, width, k, inv);
+            memcpy(out + n, row + n, row_padded - n);
         }
 
-        for (int p = width * 3; p < row_padded; p++) {
-            output_rows[y][p] = temp_rows[y][p];
+        blur_vertical(temp, dst[i], width, height, row_padded, k, inv);
+    }
+
+    pool_devolver(temp);
+    pool_devolver(prefijos);
+    pool_devolver(inv);
+    return 0;
+}
+
+// Filtros sobre una imagen ya decodificada: escriben directo en la salida mapeada
+// y registran el log. src permite reutilizar un buffer ya calculado (p. ej. grises).
+// Con `pendiente` la salida terminada pasa a la etapa de escritura diferida y cuenta
+// para esa imagen; con NULL se cierra en el momento. Devuelven 0 si la salida se generó.
+
+// FILTROS_GRIS_8BITS=1 escribe las salidas grises como BMP de 8 bits con paleta de
+// grises (un tercio del tamaño); por defecto siguen siendo de 24 bits.
+int salida_gris_8bits() {
+    const char* env = getenv("FILTROS_GRIS_8BITS");
+    return env && strcmp(env, "1") == 0;
+}
+
+// Grises y espejos de una imagen en una sola pasada (grises_espejos_buffer). outs tiene
+// una ruta por filtro, de FILTRO_GRISES a FILTRO_ESPEJO_V_GRIS; NULL omite esa salida.
+// generadas[f] queda en 1 por cada salida escrita. Devuelve cuántas se generaron.
+int grises_espejos_img(const ImagenBMP* img, const char* const* outs, const char* nombre_base,
+                       ImagenPendiente* pendiente, int* generadas) {
+    SalidaBMP salidas[FILTRO_BLUR];
+    unsigned char* datos[FILTRO_BLUR];
+    int gris_8bits = salida_gris_8bits();
+    int n_salidas = 0;
+    long long escrituras = 0;
+
+    for (int f = 0; f < FILTRO_BLUR; f++) {
+        int es_gris = f == FILTRO_GRISES || f == FILTRO_ESPEJO_H_GRIS || f == FILTRO_ESPEJO_V_GRIS;
+        int ocho = es_gris && gris_8bits;
+        generadas[f] = outs[f] && (ocho ? crear_salida_bmp_gris8(outs[f], img, &salidas[f])
+                                        : crear_salida_bmp(outs[f], img, &salidas[f])) == 0;
+        datos[f] = generadas[f] ? salidas[f].data : NULL;
+        if (generadas[f]) {
+            n_salidas++;
+            escrituras += ocho ? (long long)tam_gris8(img) : (long long)img->tam;
         }
     }
+    if (n_salidas == 0) return 0;
 
-    for (int i = 0; i < height; i++) {
-        fwrite(output_rows[i], sizeof(unsigned char), row_padded, outputImage);
-        free(input_rows[i]);
-        free(output_rows[i]);
-        free(temp_rows[i]);
-        localidades_escritas += row_padded;
+    MedicionHW m;
+    medicion_iniciar(&m, FILTRO_GRISES_ESPEJOS, paralelo_interno(img->ancho, img->alto));
+    grises_espejos_buffer(img->data, datos[FILTRO_GRISES], datos[FILTRO_ESPEJO_H_GRIS], datos[FILTRO_ESPEJO_V_GRIS],
+                          datos[FILTRO_ESPEJO_H_COLOR], datos[FILTRO_ESPEJO_V_COLOR], img->ancho, img->alto,
+                          img->row_padded, gris_8bits);
+    medicion_terminar(&m);
+
+    for (int f = 0; f < FILTRO_BLUR; f++) {
+        if (generadas[f]) entregar_salida(&salidas[f], pendiente);
     }
+    medicion_registrar(&m, img->tam, escrituras);
+    generar_log(nombre_base, "grises_espejos", img->tam, escrituras, &m);
+    return n_salidas;
+}
 
-    double t1 = omp_get_wtime();
-    double tiempo_total = t1 - t0;
+int mirror_horizontal_img(const ImagenBMP* img, const unsigned char* src, const char* out, const char* nombre_base, const char* tipo,
+                           ImagenPendiente* pendiente) {
+    SalidaBMP salida;
+    if (crear_salida_bmp(out, img, &salida) != 0) return -1;
+
+    MedicionHW m;
+    medicion_iniciar(&m, filtro_indice(tipo), paralelo_interno(img->ancho, img->alto));
+    espejo_horizontal_buffer(src, salida.data, img->ancho, img->alto, img->row_padded);
+    medicion_terminar(&m);
+
+    entregar_salida(&salida, pendiente);
+    long long pixeles = (long long)img->ancho * img->alto * 3;
+    medicion_registrar(&m, pixeles, pixeles);
+    generar_log(nombre_base, tipo, pixeles, pixeles, &m);
+    return 0;
+}
+
+int mirror_vertical_img(const ImagenBMP* img, const unsigned char* src, const char* out, const char* nombre_base, const char* tipo,
+                         ImagenPendiente* pendiente) {
+    SalidaBMP salida;
+    if (crear_salida_bmp(out, img, &salida) != 0) return -1;
 
-    generar_log(nombre_base, "blur", localidades_leidas, localidades_escritas, tiempo_total);
+    MedicionHW m;
+    medicion_iniciar(&m, filtro_indice(tipo), paralelo_interno(img->row_padded / 3, img->alto));
+    espejo_vertical_buffer(src, salida.data, img->alto, img->row_padded);
+    medicion_terminar(&m);
 
-    free(input_rows);
-    free(output_rows);
-    free(temp_rows);
-    fclose(image);
-    fclose(outputImage);
+    entregar_salida(&salida, pendiente);
+    medicion_registrar(&m, img->tam, img->tam);
+    generar_log(nombre_base, tipo, img->tam, img->tam, &m);
+    return 0;
+}
+
+int blur_img(const ImagenBMP* img, const char* out, const char* nombre_base, int kernel_size, ImagenPendiente* pendiente) {
+    SalidaBMP salida;
+    if (crear_salida_bmp(out, img, &salida) != 0) return -1;
+
+    MedicionHW m;
+    medicion_iniciar(&m, FILTRO_BLUR, paralelo_interno(img->ancho, img->alto));
+    int ok = blur_buffer(img->data, salida.data, img->ancho, img->alto, img->row_padded, kernel_size);
+    medicion_terminar(&m);
+
+    if (ok == 0) {
+        entregar_salida(&salida, pendiente);
+        long long bytes = img->offset_pixels + img->tam;
+        medicion_registrar(&m, bytes, bytes);
+        generar_log(nombre_base, "blur", bytes, bytes, &m);
+        return 0;
+    }
+    cerrar_salida_bmp(&salida);
+    remove(out);
+    return -1;
+}
+
+// Una salida de blur por kernel (outs[i] con kernels[i]) compartiendo las sumas por
+// fila. Si alguna salida no se puede crear o un kernel es inválido no se deja ninguna.
+int blur_multi_img(const ImagenBMP* img, const char* const* outs, const char* nombre_base, const int* kernels,
+                   int n_kernels, ImagenPendiente* pendiente) {
+    SalidaBMP salidas[MAX_KERNELS_BLUR];
+    unsigned char* datos[MAX_KERNELS_BLUR];
+    int creadas = 0;
+
+    for (; creadas < n_kernels; creadas++) {
+        if (crear_salida_bmp(outs[creadas], img, &salidas[creadas]) != 0) break;
+        datos[creadas] = salidas[creadas].data;
+    }
+
+    int ok = -1;
+    MedicionHW m;
+    if (creadas == n_kernels) {
+        medicion_iniciar(&m, FILTRO_BLUR, paralelo_interno(img->ancho, img->alto));
+        ok = blur_multi_buffer(img->data, datos, img->ancho, img->alto, img->row_padded, kernels, n_kernels);
+        medicion_terminar(&m);
+    }
+
+    if (ok != 0) {
+        for (int i = 0; i < creadas; i++) {
+            cerrar_salida_bmp(&salidas[i]);
+            remove(outs[i]);
+        }
+        return -1;
+    }
+
+    for (int i = 0; i < n_kernels; i++) entregar_salida(&salidas[i], pendiente);
+    long long bytes = (long long)(img->offset_pixels + img->tam) * n_kernels;
+    medicion_registrar(&m, bytes, bytes);
+    generar_log(nombre_base, "blur", bytes, bytes, &m);
+    return 0;
+}
+
+// Interfaz por archivo: cada función decodifica la entrada por su cuenta.
+// Para procesar varias salidas de una misma imagen conviene cargar_bmp + *_img.
+
+void to_grayscale(const char* in, const char* out, const char* nombre_base) {
+    ImagenBMP img;
+    if (cargar_bmp(in, &img) != 0) return;
+    const char* outs[FILTRO_BLUR] = { NULL };
+    int generadas[FILTRO_BLUR];
+    outs[FILTRO_GRISES] = out;
+    grises_espejos_img(&img, outs, nombre_base, NULL, generadas);
+    liberar_bmp(&img);
+}
+
+void mirror_horizontal_color(const char* in, const char* out, const char* nombre_base) {
+    ImagenBMP img;
+    if (cargar_bmp(in, &img) != 0) return;
+    mirror_horizontal_img(&img, img.data, out, nombre_base, "espejo_horizontal_color", NULL);
+    liberar_bmp(&img);
+}
+
+void mirror_vertical_color(const char* in, const char* out, const char* nombre_base) {
+    ImagenBMP img;
+    if (cargar_bmp(in, &img) != 0) return;
+    mirror_vertical_img(&img, img.data, out, nombre_base, "espejo_vertical_color", NULL);
+    liberar_bmp(&img);
+}
+
+void mirror_horizontal_gray(const char* in, const char* out, const char* nombre_base) {
+    ImagenBMP img;
+    if (cargar_bmp(in, &img) != 0) return;
+    const char* outs[FILTRO_BLUR] = { NULL };
+    int generadas[FILTRO_BLUR];
+    outs[FILTRO_ESPEJO_H_GRIS] = out;
+    grises_espejos_img(&img, outs, nombre_base, NULL, generadas);
+    liberar_bmp(&img);
+}
+
+void mirror_vertical_gray(const char* in, const char* out, const char* nombre_base) {
+    ImagenBMP img;
+    if (cargar_bmp(in, &img) != 0) return;
+    const char* outs[FILTRO_BLUR] = { NULL };
+    int generadas[FILTRO_BLUR];
+    outs[FILTRO_ESPEJO_V_GRIS] = out;
+    grises_espejos_img(&img, outs, nombre_base, NULL, generadas);
+    liberar_bmp(&img);
+}
+
+void apply_blur(const char* in, const char* out, const char* nombre_base, int kernel_size) {
+    ImagenBMP img;
+    if (cargar_bmp(in, &img) != 0) return;
+    blur_img(&img, out, nombre_base, kernel_size, NULL);
+    liberar_bmp(&img);
 }
 
-#endif
\ No newline at end of file
+#endif
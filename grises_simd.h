@@ -0,0 +1,275 @@
+// grises_simd.h
+#ifndef GRISES_SIMD_H
+#define GRISES_SIMD_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GRISES_X86 1
+#include <immintrin.h>
+#endif
+
+// Conversión a grises en punto fijo: gray = (21*r + 72*g + 7*b) / 100, truncado; la
+// división entre 100 se hace como (s * 5243) >> 19, exacta para s <= 25500.
+//
+// La fórmula original es 0.21*r + 0.72*g + 0.07*b en double. Solo puede diferir del punto
+// fijo cuando s es múltiplo de 100: el valor exacto es entero y el redondeo de los
+// productos lo deja a veces justo debajo (un nivel menos al truncar). Esos pixeles, ~1%,
+// se recalculan con gris_doble, así que todas las variantes dan los bytes de siempre.
+#define GRIS_PESO_R 21
+#define GRIS_PESO_G 72
+#define GRIS_PESO_B 7
+#define GRIS_MULT 5243
+#define GRIS_SHIFT 19
+
+// Las variantes grises8_* escriben un solo byte por pixel (salida de 8 bits con paleta).
+typedef void (*grises_fila_fn)(const unsigned char* src, unsigned char* dst, int ancho);
+
+// Fórmula original, sin contracción a FMA para que dé lo mismo con cualquier -march.
+// Fuera de línea: se llama poco y así no hereda el target de las variantes SIMD.
+__attribute__((noinline, optimize("fp-contract=off")))
+unsigned char gris_doble(unsigned char b, unsigned char g, unsigned char r) {
+    return 0.21*r + 0.72*g + 0.07*b;
+}
+
+unsigned char gris_pixel(const unsigned char* p) {
+    unsigned int s = GRIS_PESO_B * p[0] + GRIS_PESO_G * p[1] + GRIS_PESO_R * p[2];
+    unsigned int q = (s * GRIS_MULT) >> GRIS_SHIFT;
+    return q * 100 == s ? gris_doble(p[0], p[1], p[2]) : (unsigned char)q;
+}
+
+void grises_fila_escalar(const unsigned char* src, unsigned char* dst, int ancho) {
+    for (int j = 0; j < ancho * 3; j += 3) {
+        unsigned char gray = gris_pixel(src + j);
+        dst[j] = dst[j + 1] = dst[j + 2] = gray;
+    }
+}
+
+void grises8_fila_escalar(const unsigned char* src, unsigned char* dst, int ancho) {
+    for (int x = 0; x < ancho; x++) dst[x] = gris_pixel(src + x * 3);
+}
+
+#ifdef GRISES_X86
+
+// Rehace con gris_doble los pixeles del bloque marcados en `mascara` (bit i = pixel i);
+// `bytes` es 3 para la salida de 24 bits y 1 para la de 8.
+void grises_corregir(const unsigned char* p, unsigned char* o, int mascara, int bytes) {
+    while (mascara) {
+        int i = __builtin_ctz(mascara);
+        mascara &= mascara - 1;
+        memset(o + i * bytes, gris_doble(p[i * 3], p[i * 3 + 1], p[i * 3 + 2]), bytes);
+    }
+}
+
+// Separa 16 pixeles BGR (48 bytes) en canales con desempaquetados sucesivos y devuelve
+// los 16 grises como enteros de 16 bits en q_lo (pixeles 0-7) y q_hi (8-15). El valor de
+// retorno marca los pixeles con s múltiplo de 100, que hay que pasar por grises_corregir.
+__attribute__((target("sse2")))
+int grises_16_sse2(const unsigned char* p, __m128i* q_lo, __m128i* q_hi) {
+    const __m128i cero = _mm_setzero_si128();
+    const __m128i cien = _mm_set1_epi16(100);
+    const __m128i peso_b = _mm_set1_epi16(GRIS_PESO_B);
+    const __m128i peso_g = _mm_set1_epi16(GRIS_PESO_G);
+    const __m128i peso_r = _mm_set1_epi16(GRIS_PESO_R);
+    const __m128i mult = _mm_set1_epi16(GRIS_MULT);
+
+    __m128i t00 = _mm_loadu_si128((const __m128i*)p);
+    __m128i t01 = _mm_loadu_si128((const __m128i*)(p + 16));
+    __m128i t02 = _mm_loadu_si128((const __m128i*)(p + 32));
+
+    __m128i t10 = _mm_unpacklo_epi8(t00, _mm_unpackhi_epi64(t01, t01));
+    __m128i t11 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t00, t00), t02);
+    __m128i t12 = _mm_unpacklo_epi8(t01, _mm_unpackhi_epi64(t02, t02));
+
+    __m128i t20 = _mm_unpacklo_epi8(t10, _mm_unpackhi_epi64(t11, t11));
+    __m128i t21 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t10, t10), t12);
+    __m128i t22 = _mm_unpacklo_epi8(t11, _mm_unpackhi_epi64(t12, t12));
+
+    __m128i t30 = _mm_unpacklo_epi8(t20, _mm_unpackhi_epi64(t21, t21));
+    __m128i t31 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t20, t20), t22);
+    __m128i t32 = _mm_unpacklo_epi8(t21, _mm_unpackhi_epi64(t22, t22));
+
+    __m128i b = _mm_unpacklo_epi8(t30, _mm_unpackhi_epi64(t31, t31));
+    __m128i g = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t30, t30), t32);
+    __m128i r = _mm_unpacklo_epi8(t31, _mm_unpackhi_epi64(t32, t32));
+
+    // s cabe en 16 bits sin signo (máximo 25500)
+    __m128i s_lo = _mm_add_epi16(_mm_add_epi16(
+                       _mm_mullo_epi16(_mm_unpacklo_epi8(b, cero), peso_b),
+                       _mm_mullo_epi16(_mm_unpacklo_epi8(g, cero), peso_g)),
+                       _mm_mullo_epi16(_mm_unpacklo_epi8(r, cero), peso_r));
+    __m128i s_hi = _mm_add_epi16(_mm_add_epi16(
+                       _mm_mullo_epi16(_mm_unpackhi_epi8(b, cero), peso_b),
+                       _mm_mullo_epi16(_mm_unpackhi_epi8(g, cero), peso_g)),
+                       _mm_mullo_epi16(_mm_unpackhi_epi8(r, cero), peso_r));
+    *q_lo = _mm_srli_epi16(_mm_mulhi_epu16(s_lo, mult), GRIS_SHIFT - 16);
+    *q_hi = _mm_srli_epi16(_mm_mulhi_epu16(s_hi, mult), GRIS_SHIFT - 16);
+    __m128i exacto_lo = _mm_cmpeq_epi16(_mm_mullo_epi16(*q_lo, cien), s_lo);
+    __m128i exacto_hi = _mm_cmpeq_epi16(_mm_mullo_epi16(*q_hi, cien), s_hi);
+    return _mm_movemask_epi8(_mm_packs_epi16(exacto_lo, exacto_hi));
+}
+
+// SSE2: 16 pixeles (48 bytes) por iteración. Los canales se separan con
+// desempaquetados sucesivos porque SSE2 no tiene pshufb.
+__attribute__((target("sse2")))
+void grises_fila_sse2(const unsigned char* src, unsigned char* dst, int ancho) {
+    const __m128i cero = _mm_setzero_si128();
+    int x = 0;
+
+    for (; x + 16 <= ancho; x += 16) {
+        __m128i q_lo, q_hi;
+        int exactos = grises_16_sse2(src + x * 3, &q_lo, &q_hi);
+
+        // Cada gris se triplica: g -> [g g g 0] en 32 bits y se compactan 4 bytes a 3
+        __m128i w[4];
+        w[0] = _mm_unpacklo_epi16(q_lo, cero);
+        w[1] = _mm_unpackhi_epi16(q_lo, cero);
+        w[2] = _mm_unpacklo_epi16(q_hi, cero);
+        w[3] = _mm_unpackhi_epi16(q_hi, cero);
+
+        unsigned char* o = dst + x * 3;
+        for (int i = 0; i < 4; i++) {
+            __m128i v = _mm_or_si128(w[i], _mm_or_si128(_mm_slli_epi32(w[i], 8), _mm_slli_epi32(w[i], 16)));
+            // [d0 d1 | d2 d3] -> 6 bytes útiles por mitad de 64 bits
+            __m128i mask_lo = _mm_set_epi32(0, 0x00FFFFFF, 0, 0x00FFFFFF);
+            __m128i mitades = _mm_or_si128(_mm_and_si128(v, mask_lo),
+                                           _mm_srli_epi64(_mm_andnot_si128(mask_lo, v), 8));
+            // Junta las dos mitades de 6 bytes en 12 bytes contiguos
+            __m128i lo = _mm_and_si128(mitades, _mm_set_epi32(0, 0, 0x0000FFFF, (int)0xFFFFFFFF));
+            __m128i hi = _mm_srli_si128(mitades, 2);
+            __m128i doce = _mm_or_si128(lo, _mm_andnot_si128(_mm_set_epi32(0, 0, 0x0000FFFF, (int)0xFFFFFFFF), hi));
+            _mm_storel_epi64((__m128i*)(o + i * 12), doce);
+            int cola = _mm_cvtsi128_si32(_mm_srli_si128(doce, 8));
+            memcpy(o + i * 12 + 8, &cola, 4);
+        }
+        if (exactos) grises_corregir(src + x * 3, o, exactos, 3);
+    }
+
+    grises_fila_escalar(src + x * 3, dst + x * 3, ancho - x);
+}
+
+__attribute__((target("sse2")))
+void grises8_fila_sse2(const unsigned char* src, unsigned char* dst, int ancho) {
+    int x = 0;
+    for (; x + 16 <= ancho; x += 16) {
+        __m128i q_lo, q_hi;
+        int exactos = grises_16_sse2(src + x * 3, &q_lo, &q_hi);
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(q_lo, q_hi));
+        if (exactos) grises_corregir(src + x * 3, dst + x, exactos, 1);
+    }
+    grises8_fila_escalar(src + x * 3, dst + x, ancho - x);
+}
+
+// AVX2: 8 pixeles por iteración, 4 en cada carril de 128 bits, separados con pshufb.
+__attribute__((target("avx2")))
+void grises_fila_avx2(const unsigned char* src, unsigned char* dst, int ancho) {
+    const __m256i sel_bg = _mm256_setr_epi8(0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1,
+                                            0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1);
+    const __m256i sel_r = _mm256_setr_epi8(2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1,
+                                           2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1);
+    const __m256i triple = _mm256_setr_epi8(0, 0, 0, 4, 4, 4, 8, 8, 8, 12, 12, 12, -1, -1, -1, -1,
+                                            0, 0, 0, 4, 4, 4, 8, 8, 8, 12, 12, 12, -1, -1, -1, -1);
+    const __m256i pesos_bg = _mm256_set1_epi32((GRIS_PESO_G << 16) | GRIS_PESO_B);
+    const __m256i peso_r = _mm256_set1_epi32(GRIS_PESO_R);
+    const __m256i mult = _mm256_set1_epi32(GRIS_MULT);
+    const __m256i cien = _mm256_set1_epi32(100);
+    int x = 0;
+
+    // Se leen y escriben 16 bytes desde el pixel x+4, así que se necesitan 28 bytes de fila
+    for (; (x + 8) * 3 + 4 <= ancho * 3; x += 8) {
+        const unsigned char* p = src + x * 3;
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)),
+                                            _mm_loadu_si128((const __m128i*)(p + 12)), 1);
+
+        __m256i s = _mm256_add_epi32(_mm256_madd_epi16(_mm256_shuffle_epi8(v, sel_bg), pesos_bg),
+                                     _mm256_madd_epi16(_mm256_shuffle_epi8(v, sel_r), peso_r));
+        __m256i q = _mm256_srli_epi32(_mm256_mullo_epi32(s, mult), GRIS_SHIFT);
+        __m256i out = _mm256_shuffle_epi8(q, triple);
+        int exactos = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_mullo_epi32(q, cien), s)));
+
+        unsigned char* o = dst + x * 3;
+        _mm_storeu_si128((__m128i*)o, _mm256_castsi256_si128(out));
+        _mm_storeu_si128((__m128i*)(o + 12), _mm256_extracti128_si256(out, 1));
+        if (exactos) grises_corregir(p, o, exactos, 3);
+    }
+
+    grises_fila_escalar(src + x * 3, dst + x * 3, ancho - x);
+}
+
+__attribute__((target("avx2")))
+void grises8_fila_avx2(const unsigned char* src, unsigned char* dst, int ancho) {
+    const __m256i sel_bg = _mm256_setr_epi8(0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1,
+                                            0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1);
+    const __m256i sel_r = _mm256_setr_epi8(2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1,
+                                           2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1);
+    const __m256i bajo = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                          0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m256i pesos_bg = _mm256_set1_epi32((GRIS_PESO_G << 16) | GRIS_PESO_B);
+    const __m256i peso_r = _mm256_set1_epi32(GRIS_PESO_R);
+    const __m256i mult = _mm256_set1_epi32(GRIS_MULT);
+    const __m256i cien = _mm256_set1_epi32(100);
+    int x = 0;
+
+    // Se leen 16 bytes desde el pixel x+4, así que se necesitan 28 bytes de fila
+    for (; (x + 8) * 3 + 4 <= ancho * 3; x += 8) {
+        const unsigned char* p = src + x * 3;
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)),
+                                            _mm_loadu_si128((const __m128i*)(p + 12)), 1);
+
+        __m256i s = _mm256_add_epi32(_mm256_madd_epi16(_mm256_shuffle_epi8(v, sel_bg), pesos_bg),
+                                     _mm256_madd_epi16(_mm256_shuffle_epi8(v, sel_r), peso_r));
+        __m256i q32 = _mm256_srli_epi32(_mm256_mullo_epi32(s, mult), GRIS_SHIFT);
+        __m256i q = _mm256_shuffle_epi8(q32, bajo);
+        int exactos = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_mullo_epi32(q32, cien), s)));
+
+        int g0 = _mm_cvtsi128_si32(_mm256_castsi256_si128(q));
+        int g1 = _mm_cvtsi128_si32(_mm256_extracti128_si256(q, 1));
+        memcpy(dst + x, &g0, 4);
+        memcpy(dst + x + 4, &g1, 4);
+        if (exactos) grises_corregir(p, dst + x, exactos, 1);
+    }
+
+    grises8_fila_escalar(src + x * 3, dst + x, ancho - x);
+}
+
+#endif
+
+// Elige la mejor versión disponible en el CPU actual. FILTROS_SIMD=escalar|sse2|avx2
+// fuerza una versión concreta (útil para comparar rendimiento entre nodos).
+grises_fila_fn grises_seleccionar() {
+    const char* forzar = getenv("FILTROS_SIMD");
+    if (forzar && strcmp(forzar, "escalar") == 0) return grises_fila_escalar;
+
+#ifdef GRISES_X86
+    __builtin_cpu_init();
+    int avx2 = __builtin_cpu_supports("avx2");
+    int sse2 = __builtin_cpu_supports("sse2");
+
+    if (forzar && strcmp(forzar, "sse2") == 0 && sse2) return grises_fila_sse2;
+    if (avx2 && (!forzar || strcmp(forzar, "avx2") == 0)) return grises_fila_avx2;
+    if (sse2) return grises_fila_sse2;
+#endif
+
+    return grises_fila_escalar;
+}
+
+// Misma elección que grises_seleccionar para la salida de un byte por pixel
+grises_fila_fn grises8_seleccionar() {
+    grises_fila_fn fn = grises_seleccionar();
+#ifdef GRISES_X86
+    if (fn == grises_fila_avx2) return grises8_fila_avx2;
+    if (fn == grises_fila_sse2) return grises8_fila_sse2;
+#endif
+    return grises8_fila_escalar;
+}
+
+const char* grises_nombre(grises_fila_fn fn) {
+#ifdef GRISES_X86
+    if (fn == grises_fila_avx2 || fn == grises8_fila_avx2) return "avx2";
+    if (fn == grises_fila_sse2 || fn == grises8_fila_sse2) return "sse2";
+#endif
+    return "escalar";
+}
+
+#endif
@@ -0,0 +1,198 @@
+// lista_imagenes.h
+#ifndef LISTA_IMAGENES_H
+#define LISTA_IMAGENES_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include <mpi.h>
+
+// Lista de imágenes de entrada. Solo el proceso 0 recorre el directorio (o lee un
+// manifiesto) y los demás reciben la tabla ya armada con MPI_Bcast, así la carga de
+// metadatos sobre el sistema de archivos compartido no crece con el número de procesos.
+//
+// Las rutas van empaquetadas en un solo buffer, separadas por '\0'; imagenes[i] apunta
+// dentro de él. Sin límite de imágenes ni de largo de ruta.
+//
+// FILTROS_MANIFIESTO=archivo toma la lista de ese archivo en lugar de recorrer el
+// directorio: una ruta por línea, opcionalmente seguida de un tabulador y el tamaño en
+// bytes. Las líneas sin tamaño se completan con stat (en paralelo).
+
+typedef struct {
+    int total;
+    char* rutas;
+    size_t bytes_rutas;
+    char** imagenes;
+    long long* tamanos;
+} ListaImagenes;
+
+int ends_with_bmp(const char* filename) {
+    const char* ext = strrchr(filename, '.');
+    return ext && strcmp(ext, ".bmp") == 0;
+}
+
+// Agrega una ruta al buffer empaquetado; los punteros se arman al final en lista_indexar.
+void lista_agregar(ListaImagenes* l, size_t* capacidad, int* capacidad_imagenes, const char* carpeta,
+                   const char* nombre, long long tam) {
+    size_t largo = (carpeta ? strlen(carpeta) + 1 : 0) + strlen(nombre) + 1;
+    if (l->bytes_rutas + largo > *capacidad) {
+        while (l->bytes_rutas + largo > *capacidad) *capacidad = *capacidad ? *capacidad * 2 : 1 << 16;
+        l->rutas = (char*) realloc(l->rutas, *capacidad);
+    }
+    if (l->total == *capacidad_imagenes) {
+        *capacidad_imagenes = *capacidad_imagenes ? *capacidad_imagenes * 2 : 1024;
+        l->tamanos = (long long*) realloc(l->tamanos, *capacidad_imagenes * sizeof(long long));
+    }
+
+    if (carpeta) sprintf(l->rutas + l->bytes_rutas, "%s/%s", carpeta, nombre);
+    else strcpy(l->rutas + l->bytes_rutas, nombre);
+    l->bytes_rutas += largo;
+    l->tamanos[l->total++] = tam;
+}
+
+void lista_indexar(ListaImagenes* l) {
+    l->imagenes = (char**) malloc((l->total > 0 ? l->total : 1) * sizeof(char*));
+    size_t pos = 0;
+    for (int i = 0; i < l->total; i++) {
+        l->imagenes[i] = l->rutas + pos;
+        pos += strlen(l->rutas + pos) + 1;
+    }
+}
+
+// Completa con stat los tamaños desconocidos (< 0) y descarta lo que no sea un archivo
+// regular. Los stat se reparten entre los hilos: en un sistema de archivos de red cada
+// uno es un viaje de ida y vuelta.
+void lista_completar_tamanos(ListaImagenes* l) {
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < l->total; i++) {
+        if (l->tamanos[i] >= 0) continue;
+        struct stat st;
+        if (stat(l->imagenes[i], &st) == 0 && S_ISREG(st.st_mode)) l->tamanos[i] = st.st_size;
+    }
+
+    // Compacta en orden quitando las entradas que no se pudieron usar
+    int n = 0;
+    size_t pos = 0;
+    for (int i = 0; i < l->total; i++) {
+        if (l->tamanos[i] < 0) {
+            fprintf(stderr, "[ERROR] No se puede usar la imagen: %s\n", l->imagenes[i]);
+            continue;
+        }
+        size_t largo = strlen(l->imagenes[i]) + 1;
+        memmove(l->rutas + pos, l->imagenes[i], largo);
+        l->tamanos[n++] = l->tamanos[i];
+        pos += largo;
+    }
+    l->total = n;
+    l->bytes_rutas = pos;
+    free(l->imagenes);
+    lista_indexar(l);
+}
+
+int lista_leer_directorio(const char* carpeta, ListaImagenes* l) {
+    DIR* dir = opendir(carpeta);
+    if (!dir) return -1;
+
+    size_t capacidad = 0;
+    int capacidad_imagenes = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir))) {
+        // Con d_type conocido se descartan directorios y otros sin hacer stat
+        if (entry->d_type != DT_UNKNOWN && entry->d_type != DT_REG && entry->d_type != DT_LNK) continue;
+        if (!ends_with_bmp(entry->d_name)) continue;
+        lista_agregar(l, &capacidad, &capacidad_imagenes, carpeta, entry->d_name, -1);
+    }
+    closedir(dir);
+    return 0;
+}
+
+int lista_leer_manifiesto(const char* ruta, ListaImagenes* l) {
+    FILE* f = fopen(ruta, "r");
+    if (!f) return -1;
+
+    size_t capacidad = 0;
+    int capacidad_imagenes = 0;
+    char* linea = NULL;
+    size_t tam_linea = 0;
+    ssize_t n;
+    while ((n = getline(&linea, &tam_linea, f)) > 0) {
+        while (n > 0 && (linea[n - 1] == '\n' || linea[n - 1] == '\r')) linea[--n] = '\0';
+        if (n == 0 || linea[0] == '#') continue;
+
+        long long tam = -1;
+        char* tab = strchr(linea, '\t');
+        if (tab) {
+            *tab = '\0';
+            char* fin;
+            tam = strtoll(tab + 1, &fin, 10);
+            if (fin == tab + 1 || tam < 0) tam = -1;
+        }
+        lista_agregar(l, &capacidad, &capacidad_imagenes, NULL, linea, tam);
+    }
+    free(linea);
+    fclose(f);
+    return 0;
+}
+
+// Arma la lista en el proceso 0 y la difunde. Colectiva sobre `comm`.
+// Devuelve 0 si hay lista (puede estar vacía) o -1 si no se pudo leer el origen.
+int lista_imagenes_cargar(const char* carpeta, MPI_Comm comm, ListaImagenes* l) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    memset(l, 0, sizeof(ListaImagenes));
+
+    // total y bytes_rutas; total = -1 indica error en el proceso 0
+    long long cabecera[2] = { 0, 0 };
+    if (rank == 0) {
+        const char* manifiesto = getenv("FILTROS_MANIFIESTO");
+        int ok;
+        if (manifiesto && manifiesto[0]) {
+            ok = lista_leer_manifiesto(manifiesto, l);
+            if (ok != 0) fprintf(stderr, "No se pudo abrir el manifiesto '%s'\n", manifiesto);
+        } else {
+            ok = lista_leer_directorio(carpeta, l);
+            if (ok != 0) fprintf(stderr, "No se pudo abrir el directorio '%s': %s\n", carpeta, strerror(errno));
+        }
+        if (ok == 0) {
+            lista_indexar(l);
+            lista_completar_tamanos(l);
+            cabecera[0] = l->total;
+            cabecera[1] = (long long) l->bytes_rutas;
+        } else {
+            cabecera[0] = -1;
+        }
+    }
+
+    MPI_Bcast(cabecera, 2, MPI_LONG_LONG, 0, comm);
+    if (cabecera[0] < 0) return -1;
+
+    l->total = (int) cabecera[0];
+    l->bytes_rutas = (size_t) cabecera[1];
+    if (rank != 0) {
+        l->rutas = (char*) malloc(l->bytes_rutas > 0 ? l->bytes_rutas : 1);
+        l->tamanos = (long long*) malloc((l->total > 0 ? l->total : 1) * sizeof(long long));
+    }
+
+    // Las rutas pueden pasar de INT_MAX bytes con listas muy grandes: se envían por tramos
+    MPI_Bcast(l->tamanos, l->total, MPI_LONG_LONG, 0, comm);
+    for (size_t pos = 0; pos < l->bytes_rutas; pos += 1 << 30) {
+        size_t tramo = l->bytes_rutas - pos < (size_t)1 << 30 ? l->bytes_rutas - pos : (size_t)1 << 30;
+        MPI_Bcast(l->rutas + pos, (int) tramo, MPI_CHAR, 0, comm);
+    }
+    if (rank != 0) lista_indexar(l);
+    return 0;
+}
+
+void lista_imagenes_liberar(ListaImagenes* l) {
+    free(l->imagenes);
+    free(l->rutas);
+    free(l->tamanos);
+    memset(l, 0, sizeof(ListaImagenes));
+}
+
+#endif
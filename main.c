@@ -1,57 +1,34 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <string.h>
-#include <dirent.h>
 #include <omp.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <sys/resource.h>
 #include "filtros_img.h"
 #include <unistd.h>
 #include <mpi.h>
-
-#define MAX_IMAGENES 600
-
-void configure_threads_by_host() {
-    char hostname[1024];
-    gethostname(hostname, sizeof(hostname));
-
-    if (strstr(hostname, "master")) {
-        omp_set_num_threads(20);
-    } else if (strstr(hostname, "luis-QEMU-Virtual-Machine")) {
-        omp_set_num_threads(4);
-    } else if (strstr(hostname, "slave2")) {
-        omp_set_num_threads(4);
-    } else {
-        omp_set_num_threads(2); 
-
-    #pragma omp parallel
-    {
-        #pragma omp single
-        printf("Host %s usando %d hilos (OpenMP)\n", hostname, omp_get_num_threads());
-    }
-}
-
-void compare_execution_costs(double total_exec_time_seconds) {
-    double total_kwh_week = 13.559;
-
+#include "reparto_mpi.h"
+#include "cache_resultados.h"
+#include "blur_mpi.h"
+#include "lista_imagenes.h"
+#include "topologia.h"
+#include "servicio.h"
+#include "piramide.h"
+
+// Costos a partir de la energía medida en la corrida (energia.h), sumada entre procesos
+void compare_execution_costs(double total_exec_time_seconds, double joules, const char* fuente) {
     // Energy price in USD per kWh (with subsidy)
     double cost_kwh_usd = 0.013;
 
     // Annual maintenance cost (USD)
     double annual_maintenance_usd = 78.17 + 62.53 + 20.84;
 
-    // Equipment cost (MXN)
-    double equipment_cost_mxn = 37429 + 11239 + 9709;
-    double exchange_rate = 19.0;
-    double equipment_cost_usd = equipment_cost_mxn / exchange_rate;
-
     // AWS annual cost (fixed)
     double aws_annual_cost_usd = 3047.16;
 
-    // Weekly execution time in seconds (8h/day * 5 days)
-    double seconds_per_week = 40.0 * 60.0 * 60.0;
-
-    // Energy consumed proportionally to execution time
-    double kwh_used = (total_exec_time_seconds / seconds_per_week) * total_kwh_week;
+    // Measured energy (1 kWh = 3.6e6 J)
+    double kwh_used = joules / 3.6e6;
     double local_energy_cost = kwh_used * cost_kwh_usd;
 
     // Maintenance cost proportional to execution time
@@ -60,7 +37,7 @@ void compare_execution_costs(double total_exec_time_seconds) {
     double annual_local_cost = local_total_cost * 16 * 5 * 4 * 12;
     printf("\n--- Comparación de costos de ejecución ---\n");
     printf("• Tiempo total de ejecución: %.2f segundos\n", total_exec_time_seconds);
-    printf("• Energía consumida localmente: %.6f kWh\n", kwh_used);
+    printf("• Energía consumida localmente: %.6f kWh (%.3f J, fuente: %s)\n", kwh_used, joules, fuente);
     printf("• Costo energético local: $%.4f USD\n", local_energy_cost);
     printf("• Costo de mantenimiento proporcional: $%.6f USD\n", proportional_maintenance);
     printf("• Costo total de ejecución local: $%.6f USD\n", local_total_cost);
@@ -73,6 +50,7 @@ void compare_execution_costs(double total_exec_time_seconds) {
         fprintf(cost_file, "\n=== Comparación de costos ===\n");
         fprintf(cost_file, "Tiempo de ejecución (s): %.2f\n", total_exec_time_seconds);
         fprintf(cost_file, "Consumo energético local (kWh): %.6f\n", kwh_used);
+        fprintf(cost_file, "Fuente de la medición: %s\n", fuente);
         fprintf(cost_file, "Costo energético local (USD): %.4f\n", local_energy_cost);
         fprintf(cost_file, "Costo de mantenimiento proporcional (USD): %.6f\n", proportional_maintenance);
         fprintf(cost_file, "Costo total local (USD): %.6f\n", local_total_cost);
@@ -81,162 +59,405 @@ void compare_execution_costs(double total_exec_time_seconds) {
     }
 }
 
-
-int ends_with_bmp(const char* filename) {
-    const char* ext = strrchr(filename, '.');
-    return ext && strcmp(ext, ".bmp") == 0;
+// Imágenes de al menos este número de pixeles se procesan una a la vez con todos
+// los hilos dentro de cada filtro, en lugar de un hilo por imagen.
+#define PIXELES_IMAGEN_GRANDE (1 << 22)
+
+// Política de paralelismo: una imagen usa paralelismo interno si es grande, o si el
+// proceso tiene menos imágenes que hilos (el bucle por imágenes dejaría hilos ociosos)
+// y la imagen alcanza el mínimo para que los filtros se repartan (PARALELO_MIN_PIXELES).
+int usar_paralelo_interno(long long bytes_archivo, int imagenes_locales, int hilos) {
+    long long pixeles = bytes_archivo / 3;
+    if (pixeles >= PIXELES_IMAGEN_GRANDE) return 1;
+    return imagenes_locales < hilos && pixeles >= PARALELO_MIN_PIXELES;
 }
 
-int main(int argc, char** argv) {
-    int rank, size;
-    MPI_Init(&argc, &argv);
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &size);
-
-    configure_threads_by_host();
+// Registra la salida en el canal de eventos (eventos.h). Sin canal se imprime como
+// antes; con canal la consola no se toca por cada salida.
+void informar_salida(int rank, int indice, int filtro, int kernel, const char* texto, const char* out, int en_cache,
+                     double segundos, long long bytes) {
+    if (eventos_activos) {
+        eventos_registrar(indice, filtro, kernel, en_cache, segundos, bytes);
+        return;
+    }
+    #pragma omp critical
+    {
+        printf("-> [%d] %s%s: %s\n", rank, texto, en_cache ? " (caché)" : "", out);
+        fflush(stdout);
+    }
+}
 
-    const char* carpeta = "img";
-    struct dirent* entry;
-    DIR* dir = opendir(carpeta);
+// Nombre del archivo hasta el primer punto. Los nombres más largos que el buffer se
+// recortan en lugar de desbordarlo.
+#define MAX_NOMBRE_BASE 256
+#define MAX_RUTA_SALIDA (MAX_NOMBRE_BASE + 64)
+
+void nombre_base_imagen(const char* path, char* base, size_t tam) {
+    const char* nombre = strrchr(path, '/');
+    if (!nombre) nombre = path; else nombre++;
+    const char* punto = strchr(nombre, '.');
+    size_t largo = punto ? (size_t)(punto - nombre) : strlen(nombre);
+    if (largo >= tam) largo = tam - 1;
+    memcpy(base, nombre, largo);
+    base[largo] = '\0';
+}
 
-    if (!dir) {
-        if (rank == 0)
-            perror("No se pudo abrir el directorio 'img'");
-        MPI_Finalize();
-        return 1;
+// La imagen se da por terminada (reparto_terminada) cuando todas sus salidas quedaron
+// en disco; las escriben los hilos de la etapa de escritura diferida.
+// Solo se generan los filtros marcados en `filtros` (bit f por filtro). Con n_kernels = 0
+// no se calcula el blur (no se pidió o ya lo hizo blur_distribuido_imagen).
+// Con preview > 0 los filtros corren sobre ese nivel de la pirámide (piramide.h), con el
+// kernel escalado, y las salidas van a CARPETA_PREVIEW sin pasar por la caché. El blur
+// se nombra con el kernel pedido, no con el escalado (dos kernels pueden escalar al mismo):
+// cada vista previa lleva el nombre de la salida final que anticipa. Con el contenedor de
+// salidas activo tampoco se usa la caché: no hay archivos que enlazar.
+#define CARPETA_SALIDA "/home/mpiu/destinoBash"
+#define CARPETA_PREVIEW CARPETA_SALIDA "/preview"
+
+void procesar_imagen(const char* path, int indice, int rank, int filtros, int preview, const int* kernels,
+                     int n_kernels) {
+    char base[MAX_NOMBRE_BASE], nombre_log[MAX_NOMBRE_BASE + 24];
+    nombre_base_imagen(path, base, sizeof(base));
+    if (preview > 0) snprintf(nombre_log, sizeof(nombre_log), "%s_preview%d", base, preview);
+    else snprintf(nombre_log, sizeof(nombre_log), "%s", base);
+    const char* destino = preview > 0 ? CARPETA_PREVIEW : CARPETA_SALIDA;
+
+    #pragma omp critical
+    {
+        printf("Proceso %d procesando imagen: %s\n", rank, base);
+        fflush(stdout);
     }
 
-    int kernel_size;
-    if (rank == 0) {
-        if (argc < 2) {
-            printf("Error: se requiere el tamaño del kernel como argumento.\n");
-            MPI_Abort(MPI_COMM_WORLD, 1);
-            return 1;
+    char out1[MAX_RUTA_SALIDA], out2[MAX_RUTA_SALIDA], out3[MAX_RUTA_SALIDA], out4[MAX_RUTA_SALIDA], out5[MAX_RUTA_SALIDA];
+    char outs_blur[MAX_KERNELS_BLUR][MAX_RUTA_SALIDA];
+    snprintf(out1, sizeof(out1), "%s/%s_gray.bmp", destino, base);
+    snprintf(out2, sizeof(out2), "%s/%s_hinv_color.bmp", destino, base);
+    snprintf(out3, sizeof(out3), "%s/%s_vinv_color.bmp", destino, base);
+    snprintf(out4, sizeof(out4), "%s/%s_hinv_gray.bmp", destino, base);
+    snprintf(out5, sizeof(out5), "%s/%s_vinv_gray.bmp", destino, base);
+    for (int i = 0; i < n_kernels; i++)
+        snprintf(outs_blur[i], sizeof(outs_blur[i]), "%s/%s_blur_%d.bmp", destino, base, kernels[i]);
+
+    ImagenPendiente* pendiente = imagen_pendiente_crear(indice, reparto_terminada);
+    ImagenBMP img;
+    if (cargar_bmp(path, &img) != 0) {
+        imagen_pendiente_soltar(pendiente);
+        return;
+    }
+    ImagenBMP original = img;
+    NivelPiramide nivel;
+    if (preview > 0) {
+        if (piramide_nivel(&original, preview, &nivel) != 0) {
+            liberar_bmp(&original);
+            imagen_pendiente_soltar(pendiente);
+            return;
         }
-
-        kernel_size = atoi(argv[1]);
-        if (kernel_size < 55 || kernel_size > 155 || kernel_size % 2 == 0) {
-            printf("Tamaño de kernel inválido. Se usará 105 por defecto.\n");
-            kernel_size = 105;
+        img = nivel.img;
+    }
+    int usar_cache = cache_activa && preview == 0 && !salidas_en_memoria;
+
+    // Las salidas que ya están en la caché de resultados se enlazan sin calcularlas.
+    // Los índices siguen el orden de los filtros (FILTRO_GRISES ... FILTRO_ESPEJO_V_GRIS);
+    // el blur lleva una entrada por kernel.
+    const char* salidas[FILTRO_BLUR] = { out1, out2, out3, out4, out5 };
+    char rutas_cache[FILTRO_BLUR][600], rutas_cache_blur[MAX_KERNELS_BLUR][600];
+    int en_cache[FILTRO_BLUR] = { 0 }, blur_en_cache[MAX_KERNELS_BLUR] = { 0 };
+    if (usar_cache) {
+        unsigned long long hash = cache_hash(img.header, img.tam_mapa);
+        int gris_8bits = salida_gris_8bits();
+        for (int f = 0; f < FILTRO_BLUR; f++) {
+            if (!(filtros & (1 << f))) continue;
+            int es_gris = f == FILTRO_GRISES || f == FILTRO_ESPEJO_H_GRIS || f == FILTRO_ESPEJO_V_GRIS;
+            cache_ruta(rutas_cache[f], sizeof(rutas_cache[f]), hash, img.tam_mapa, f, 0,
+                       es_gris && gris_8bits ? "8bits" : NULL);
+            en_cache[f] = cache_restaurar(rutas_cache[f], salidas[f], f);
+        }
+        for (int i = 0; i < n_kernels; i++) {
+            cache_ruta(rutas_cache_blur[i], sizeof(rutas_cache_blur[i]), hash, img.tam_mapa, FILTRO_BLUR, kernels[i], NULL);
+            blur_en_cache[i] = cache_restaurar(rutas_cache_blur[i], outs_blur[i], FILTRO_BLUR);
         }
+    }
 
-        printf("Kernel size recibido desde GUI: %d\n", kernel_size);
+    // Grises y los cuatro espejos que falten salen de una sola pasada por la imagen
+    static const char* textos[FILTRO_BLUR] = {
+        "Filtro gris aplicado", "Espejo horizontal color", "Espejo vertical color",
+        "Espejo horizontal gris", "Espejo vertical gris"
+    };
+    // La duración de cada pasada se reparte entre las salidas que produjo
+    const char* faltantes[FILTRO_BLUR];
+    int generadas[FILTRO_BLUR];
+    for (int f = 0; f < FILTRO_BLUR; f++) faltantes[f] = (filtros & (1 << f)) && !en_cache[f] ? salidas[f] : NULL;
+    double t0 = omp_get_wtime();
+    int n_generadas = grises_espejos_img(&img, faltantes, nombre_log, pendiente, generadas);
+    double t_salida = n_generadas > 0 ? (omp_get_wtime() - t0) / n_generadas : 0;
+    long long bytes_color = img.offset_pixels + (long long)img.tam;
+    long long bytes_gris = salida_gris_8bits() ? BMP_GRIS8_OFFSET + (long long)tam_gris8(&img) : bytes_color;
+    for (int f = 0; f < FILTRO_BLUR; f++) {
+        if (!(filtros & (1 << f))) continue;
+        int es_gris = f == FILTRO_GRISES || f == FILTRO_ESPEJO_H_GRIS || f == FILTRO_ESPEJO_V_GRIS;
+        if (generadas[f] && usar_cache) cache_guardar(pendiente, salidas[f], rutas_cache[f]);
+        informar_salida(rank, indice, f, 0, textos[f], salidas[f], en_cache[f], generadas[f] ? t_salida : 0,
+                        es_gris ? bytes_gris : bytes_color);
     }
 
-    MPI_Bcast(&kernel_size, 1, MPI_INT, 0, MPI_COMM_WORLD);
-    if (rank == 0) printf("Procesando imágenes...\n");
+    // Todos los kernels que faltan salen de una sola pasada de blur_multi_img
+    const char* blur_pendientes[MAX_KERNELS_BLUR];
+    int kernels_pendientes[MAX_KERNELS_BLUR], indices_pendientes[MAX_KERNELS_BLUR];
+    int n_pendientes = 0;
+    for (int i = 0; i < n_kernels; i++) {
+        if (blur_en_cache[i]) continue;
+        blur_pendientes[n_pendientes] = outs_blur[i];
+        kernels_pendientes[n_pendientes] = preview > 0 ? piramide_kernel(kernels[i], preview) : kernels[i];
+        indices_pendientes[n_pendientes++] = i;
+    }
+    t0 = omp_get_wtime();
+    if (n_pendientes > 0 &&
+        blur_multi_img(&img, blur_pendientes, nombre_log, kernels_pendientes, n_pendientes, pendiente) == 0 && usar_cache) {
+        for (int j = 0; j < n_pendientes; j++)
+            cache_guardar(pendiente, outs_blur[indices_pendientes[j]], rutas_cache_blur[indices_pendientes[j]]);
+    }
+    t_salida = n_pendientes > 0 ? (omp_get_wtime() - t0) / n_pendientes : 0;
+    for (int i = 0; i < n_kernels; i++) {
+        informar_salida(rank, indice, FILTRO_BLUR, kernels[i], "Blur", outs_blur[i], blur_en_cache[i],
+                        blur_en_cache[i] ? 0 : t_salida, bytes_color);
+    }
 
-    char* imagenes[MAX_IMAGENES];
-    int total = 0;
-
-    while ((entry = readdir(dir)) && total < MAX_IMAGENES) {
-        char ruta_completa[256];
-        snprintf(ruta_completa, sizeof(ruta_completa), "%s/%s", carpeta, entry->d_name);
-        struct stat st;
-        if (stat(ruta_completa, &st) == 0 && S_ISREG(st.st_mode) && ends_with_bmp(entry->d_name)) {
-            imagenes[total] = malloc(256);
-            strcpy(imagenes[total], ruta_completa);
-            total++;
+    if (preview > 0) piramide_liberar(&nivel);
+    liberar_bmp(&original);
+    imagen_pendiente_soltar(pendiente);
+}
+
+// Imágenes de al menos este número de bytes se difuminan entre todos los procesos
+// cuando hay menos imágenes que procesos (ver blur_distribuido_imagen).
+// FILTROS_BLUR_DISTRIBUIDO=1 lo fuerza para toda imagen y =0 lo desactiva.
+#define BYTES_BLUR_DISTRIBUIDO (3LL * PIXELES_IMAGEN_GRANDE)
+
+int usar_blur_distribuido(long long bytes_archivo, int total, int size) {
+    const char* env = getenv("FILTROS_BLUR_DISTRIBUIDO");
+    if (size < 2 || (env && strcmp(env, "0") == 0)) return 0;
+    if (env && strcmp(env, "1") == 0) return 1;
+    return total < size && bytes_archivo >= BYTES_BLUR_DISTRIBUIDO;
+}
+
+// Colectiva: todos los procesos difuminan juntos una imagen, por franjas (blur_mpi.h).
+// El proceso 0 consulta y alimenta la caché y reporta las salidas. Devuelve 0 si
+// quedaron todos los blurs; si no, la imagen se procesa completa por la vía normal.
+int blur_distribuido_imagen(const char* path, int indice, int rank, const int* kernels, int n_kernels) {
+    char base[MAX_NOMBRE_BASE];
+    nombre_base_imagen(path, base, sizeof(base));
+
+    ImagenCompartida ic;
+    if (imagen_compartida_cargar(path, MPI_COMM_WORLD, &ic) != 0) {
+        imagen_compartida_liberar(&ic);
+        return -1;
+    }
+
+    char outs_blur[MAX_KERNELS_BLUR][MAX_RUTA_SALIDA], rutas_cache[MAX_KERNELS_BLUR][600];
+    int en_cache[MAX_KERNELS_BLUR] = { 0 };
+    for (int i = 0; i < n_kernels; i++)
+        snprintf(outs_blur[i], sizeof(outs_blur[i]), CARPETA_SALIDA "/%s_blur_%d.bmp", base, kernels[i]);
+    if (rank == 0 && cache_activa) {
+        unsigned long long hash = cache_hash(ic.img.header, ic.img.tam_mapa);
+        for (int i = 0; i < n_kernels; i++) {
+            cache_ruta(rutas_cache[i], sizeof(rutas_cache[i]), hash, ic.img.tam_mapa, FILTRO_BLUR, kernels[i], NULL);
+            en_cache[i] = cache_restaurar(rutas_cache[i], outs_blur[i], FILTRO_BLUR);
+        }
+    }
+    MPI_Bcast(en_cache, n_kernels, MPI_INT, 0, MPI_COMM_WORLD);
+
+    int error = 0;
+    double segundos[MAX_KERNELS_BLUR] = { 0 };
+    for (int i = 0; i < n_kernels && !error; i++) {
+        if (en_cache[i]) continue;
+        double t0 = omp_get_wtime();
+        error = blur_franjas_mpi(&ic.img, outs_blur[i], base, kernels[i], MPI_COMM_WORLD) != 0;
+        segundos[i] = omp_get_wtime() - t0;
+        // MPI_File_sync ya dejó la salida en disco: se puede publicar en la caché
+        if (!error && rank == 0) cache_guardar_ahora(outs_blur[i], rutas_cache[i]);
+    }
+    if (!error && rank == 0) {
+        for (int i = 0; i < n_kernels; i++) {
+            informar_salida(rank, indice, FILTRO_BLUR, kernels[i], "Blur", outs_blur[i], en_cache[i], segundos[i],
+                            (long long) ic.img.tam_mapa);
         }
     }
-    closedir(dir);
 
-    double inicio_local = omp_get_wtime();
+    imagen_compartida_liberar(&ic);
+    return error ? -1 : 0;
+}
 
-    #pragma omp parallel
-    {
-        #pragma omp single
-        printf("Proceso %d usando %d hilos OpenMP\n", rank, omp_get_num_threads());
-
-        #pragma omp for
-        for (int i = rank; i < total; i += size) {
-            const char* path = imagenes[i];
-            const char* nombre = strrchr(path, '/');
-            char base[64];
-            if (!nombre) nombre = path; else nombre++;
-            strncpy(base, nombre, strchr(nombre, '.') - nombre);
-            base[strchr(nombre, '.') - nombre] = '\0';
-
-            #pragma omp critical
-            {
-                printf("Proceso %d procesando imagen: %s\n", rank, base);
-                fflush(stdout);
-            }
+typedef struct {
+    char** imagenes;
+    const long long* tamanos;
+    int rank;
+    int filtros;
+    int preview;
+    const int* kernels;
+    int n_kernels;
+    const int* blur_hecho;
+} ContextoLote;
+
+// Procesa un lote recibido de la cola: primero las imágenes que usan paralelismo
+// interno (una a la vez), luego el resto con un hilo por imagen.
+void procesar_lote(const int* lote, int n, void* arg) {
+    ContextoLote* ctx = (ContextoLote*) arg;
+    int hilos = omp_get_max_threads();
+    int pequenas[MAX_LOTE];
+    int n_pequenas = 0;
+
+    for (int j = 0; j < n; j++) {
+        int i = lote[j];
+        if (!usar_paralelo_interno(ctx->tamanos[i], n, hilos)) {
+            pequenas[n_pequenas++] = i;
+            continue;
+        }
+        procesar_imagen(ctx->imagenes[i], i, ctx->rank, ctx->filtros, ctx->preview, ctx->kernels,
+                        ctx->blur_hecho[i] ? 0 : ctx->n_kernels);
+    }
 
-            char out1[100], out2[100], out3[100], out4[100], out5[100], out6[100];
-            sprintf(out1, "/home/mpiu/destinoBash/%s_gray.bmp", base);
-            sprintf(out2, "/home/mpiu/destinoBash/%s_hinv_color.bmp", base);
-            sprintf(out3, "/home/mpiu/destinoBash/%s_vinv_color.bmp", base);
-            sprintf(out4, "/home/mpiu/destinoBash/%s_hinv_gray.bmp", base);
-            sprintf(out5, "/home/mpiu/destinoBash/%s_vinv_gray.bmp", base);
-            sprintf(out6, "/home/mpiu/destinoBash/%s_blur_%d.bmp", base, kernel_size);
+    #pragma omp parallel for schedule(dynamic)
+    for (int j = 0; j < n_pequenas; j++) {
+        int i = pequenas[j];
+        procesar_imagen(ctx->imagenes[i], i, ctx->rank, ctx->filtros, ctx->preview, ctx->kernels,
+                        ctx->blur_hecho[i] ? 0 : ctx->n_kernels);
+    }
+}
 
-            to_grayscale(path, out1, base);
-            #pragma omp critical
-            { printf("-> [%d] Filtro gris aplicado: %s\n", rank, out1); fflush(stdout); }
+// Un trabajo completo con todos los procesos: lista de imágenes, blur distribuido,
+// reparto dinámico y reporte. Colectiva. Devuelve -1 si no se pudo leer la entrada.
+int ejecutar_trabajo(const Trabajo* t, int rank, int size, int hilo_mpi) {
+    // Solo se cuenta el blur si se pidió
+    const int* kernels = t->kernels;
+    int n_kernels = t->filtros & (1 << FILTRO_BLUR) ? t->n_kernels : 0;
+    int salidas_por_imagen = n_kernels;
+    for (int f = 0; f < FILTRO_BLUR; f++) salidas_por_imagen += (t->filtros >> f) & 1;
+
+    // El proceso 0 recorre la carpeta (o lee el manifiesto) una sola vez y difunde la lista
+    ListaImagenes lista;
+    if (lista_imagenes_cargar(t->carpeta, MPI_COMM_WORLD, &lista) != 0) return -1;
+    char** imagenes = lista.imagenes;
+    long long* tamanos = lista.tamanos;
+    int total = lista.total;
+
+    // Canal de progreso para la interfaz (FILTROS_EVENTOS); el primer registro dice
+    // cuántas salidas esperar
+    eventos_iniciar(rank, MPI_COMM_WORLD);
+    if (rank == 0) eventos_inicio(total, salidas_por_imagen, size);
+
+    // Cada trabajo se mide por separado (en el modo servicio corren varios)
+    contadores_reiniciar();
+    pool_reiniciar_pico();
+    memset(cache_aciertos, 0, sizeof(cache_aciertos));
+    memset(cache_fallos, 0, sizeof(cache_fallos));
 
-            mirror_horizontal_color(path, out2, base);
-            #pragma omp critical
-            { printf("-> [%d] Espejo horizontal color: %s\n", rank, out2); fflush(stdout); }
+    double inicio_local = omp_get_wtime();
+    double energia_inicio = energia_leer();
 
-            mirror_vertical_color(path, out3, base);
-            #pragma omp critical
-            { printf("-> [%d] Espejo vertical color: %s\n", rank, out3); fflush(stdout); }
+    printf("Proceso %d usando %d hilos OpenMP\n", rank, omp_get_max_threads());
 
-            mirror_horizontal_gray(path, out4, base);
-            #pragma omp critical
-            { printf("-> [%d] Espejo horizontal gris: %s\n", rank, out4); fflush(stdout); }
+    // Reparto dinámico: cada proceso pide lotes al proceso 0 conforme termina,
+    // empezando por las imágenes más grandes
+    // Las salidas se escriben en disco en hilos aparte mientras se calculan las siguientes
+    cache_iniciar(CARPETA_SALIDA, rank);
+    if (t->preview > 0) mkdir(CARPETA_PREVIEW, 0755);
 
-            mirror_vertical_gray(path, out5, base);
-            #pragma omp critical
-            { printf("-> [%d] Espejo vertical gris: %s\n", rank, out5); fflush(stdout); }
+    // FILTROS_CONTENEDOR: las salidas y logs del proceso van a un solo archivo
+    // (contenedor.h) en lugar de uno por salida; no se usa para las vistas previas
+    salidas_en_memoria = t->preview == 0 && contenedor_iniciar(rank) == 0;
 
-            apply_blur(path, out6, base, kernel_size);
-            #pragma omp critical
-            { printf("-> [%d] Blur: %s\n", rank, out6); fflush(stdout); }
+    // Con menos imágenes que procesos, el blur de las imágenes grandes se reparte por
+    // franjas entre todos; el resto de sus filtros sigue por la cola normal. La decisión
+    // la toma el proceso 0 para que todos entren a las mismas operaciones colectivas.
+    int* blur_hecho = (int*) calloc(total > 0 ? total : 1, sizeof(int));
+    if (rank == 0) {
+        for (int i = 0; i < total && t->preview == 0 && !salidas_en_memoria; i++)
+            blur_hecho[i] = usar_blur_distribuido(tamanos[i], total, size);
+    }
+    MPI_Bcast(blur_hecho, total, MPI_INT, 0, MPI_COMM_WORLD);
+    for (int i = 0; i < total && n_kernels > 0; i++) {
+        if (blur_hecho[i]) blur_hecho[i] = blur_distribuido_imagen(imagenes[i], i, rank, kernels, n_kernels) == 0;
+    }
 
-            free(imagenes[i]);
-        }
+    escritura_iniciar(0);
+    ContextoLote ctx = { imagenes, tamanos, rank, t->filtros, t->preview, kernels, n_kernels, blur_hecho };
+    reparto_dinamico(imagenes, tamanos, total, rank, size, hilo_mpi, procesar_lote, &ctx);
+    escritura_finalizar();
+    // La caché está junto al destino (mismo sistema de archivos), la recorta uno solo
+    if (rank == 0) cache_recortar();
+    if (salidas_en_memoria) {
+        if (contenedor_finalizar() != 0) fprintf(stderr, "Proceso %d: el contenedor de salidas quedó incompleto\n", rank);
+        salidas_en_memoria = 0;
     }
+    if (rank == 0) eventos_vaciar_local(rank, imagenes);
+    lista_imagenes_liberar(&lista);
+    free(blur_hecho);
 
     double fin_local = omp_get_wtime();
+    double energia_local = energia_corrida(energia_inicio, energia_leer());
     double tiempo_local = fin_local - inicio_local;
 
     // Time of all processes
     double tiempo_maximo = 0;
     MPI_Reduce(&tiempo_local, &tiempo_maximo, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    long long descartados = 0;
+    MPI_Reduce(&eventos_descartados, &descartados, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        if (descartados > 0) fprintf(stderr, "[AVISO] Se descartaron %lld eventos de progreso\n", descartados);
+        eventos_fin(tiempo_maximo, descartados);
+    }
+
+    // Memoria pico por proceso: buffers del pool y RSS máximo (ru_maxrss está en KB)
+    struct rusage uso;
+    getrusage(RUSAGE_SELF, &uso);
+    long long memoria_local[2] = { pool_memoria_pico(), (long long)uso.ru_maxrss * 1024LL };
+    long long* memoria = NULL;
+    if (rank == 0) memoria = (long long*) malloc(2 * size * sizeof(long long));
+    MPI_Gather(memoria_local, 2, MPI_LONG_LONG, memoria, 2, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+
+    // Contadores de hardware por filtro: se suman los hilos de cada proceso y luego
+    // todos los procesos con MPI
+    long long contadores_local[N_FILTROS * CAMPOS_FILTRO_HW], contadores[N_FILTROS * CAMPOS_FILTRO_HW];
+    double tiempos_local[N_FILTROS], tiempos_filtro[N_FILTROS];
+    double energia_filtro_local[N_FILTROS], energia_filtro[N_FILTROS];
+    int sin_contadores_local, procesos_sin_contadores = 0;
+    contadores_resumen_proceso(contadores_local, tiempos_local, energia_filtro_local, &sin_contadores_local);
+    MPI_Reduce(contadores_local, contadores, N_FILTROS * CAMPOS_FILTRO_HW, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(tiempos_local, tiempos_filtro, N_FILTROS, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&sin_contadores_local, &procesos_sin_contadores, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    // Energía de la corrida (las fuentes de nodo las aporta un proceso por nodo) y la
+    // muestreada en las fases de cada filtro; cuántos procesos usaron cada fuente
+    double energia_total = 0;
+    int fuentes_local[ENERGIA_N_FUENTES] = { 0 }, fuentes[ENERGIA_N_FUENTES];
+    if (energia_fuente >= 0) fuentes_local[energia_fuente] = 1;
+    MPI_Reduce(&energia_local, &energia_total, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(energia_filtro_local, energia_filtro, N_FILTROS, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(fuentes_local, fuentes, ENERGIA_N_FUENTES, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    // Aciertos y fallos de la caché de resultados por filtro, sumados entre procesos
+    long long cache_local[2 * N_FILTROS], cache_total[2 * N_FILTROS];
+    memcpy(cache_local, cache_aciertos, sizeof(cache_aciertos));
+    memcpy(cache_local + N_FILTROS, cache_fallos, sizeof(cache_fallos));
+    MPI_Reduce(cache_local, cache_total, 2 * N_FILTROS, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    char ruta_detalle[64];
+    snprintf(ruta_detalle, sizeof(ruta_detalle), "./logs/contadores_proceso_%d.txt", rank);
+    contadores_escribir_detalle(ruta_detalle, rank);
 
     if (rank == 0) {
         printf("\nTiempo real de ejecución (mayor entre todos los procesos): %.4f segundos\n", tiempo_maximo);
 
-        long long total_lecturas = 0;
-        long long total_escrituras = 0;
-        DIR* logdir = opendir("./logs");
-        struct dirent* logentry;
-
-        if (logdir) {
-            while ((logentry = readdir(logdir))) {
-                if (strstr(logentry->d_name, ".txt")) {
-                    char logpath[256];
-                    snprintf(logpath, sizeof(logpath), "./logs/%s", logentry->d_name);
-                    FILE* logf = fopen(logpath, "r");
-                    if (logf) {
-                        char buffer[128];
-                        while (fgets(buffer, sizeof(buffer), logf)) {
-                            long long lecturas = 0, escrituras = 0;
-                            if (sscanf(buffer, "Lecturas: %lld", &lecturas) == 1)
-                                total_lecturas += lecturas;
-                            if (sscanf(buffer, "Escrituras: %lld", &escrituras) == 1)
-                                total_escrituras += escrituras;
-                        }
-                        fclose(logf);
-                    }
-                }
-            }
-            closedir(logdir);
+        long long instrucciones_totales = 0, ciclos_totales = 0, fallos_totales = 0;
+        long long total_lecturas = 0, total_escrituras = 0;
+        for (int f = 0; f < N_FILTROS; f++) {
+            const long long* v = contadores + f * CAMPOS_FILTRO_HW;
+            instrucciones_totales += v[1 + HW_INSTRUCCIONES];
+            ciclos_totales += v[1 + HW_CICLOS];
+            fallos_totales += v[1 + HW_FALLOS_CACHE];
+            total_lecturas += v[4];
+            total_escrituras += v[5];
         }
 
-        long long instrucciones_totales = (total_lecturas + total_escrituras) * 20LL;
         double tiempo_total = tiempo_maximo;
         if (tiempo_total <= 0) tiempo_total = 1e-6;
 
@@ -246,19 +467,224 @@ int main(int argc, char** argv) {
 
         FILE* resumen = fopen("./reporte_total.txt", "w");
         if (resumen) {
-	    fprintf(resumen, "Instrucciones totales: %lf\n", (double)instrucciones_totales);
+            if (procesos_sin_contadores < size)
+                fprintf(resumen, "Instrucciones totales: %lf\n", (double)instrucciones_totales);
+            else
+                fprintf(resumen, "Instrucciones totales: no disponible\n");
 	    fprintf(resumen, "Lecturas totales: %lf\n", (double)total_lecturas);
 	    fprintf(resumen, "Escrituras totales: %lf\n", (double)total_escrituras);
 	    fprintf(resumen, "Tiempo total: %lf segundos\n", tiempo_total);
-	    fprintf(resumen, "MIPS global: %.6e\n", mips_global);
+            if (procesos_sin_contadores < size)
+                fprintf(resumen, "MIPS global: %.6e\n", mips_global);
+            else
+                fprintf(resumen, "MIPS global: no disponible\n");
 	    fprintf(resumen, "Bytes por segundo global: %.6e\n", bytes_por_segundo_global);
+            fprintf(resumen, "Ciclos totales: %lf\n", (double)ciclos_totales);
+            fprintf(resumen, "Fallos de cache totales: %lf\n", (double)fallos_totales);
+            if (procesos_sin_contadores > 0) {
+                fprintf(resumen, "Contadores de hardware no disponibles en %d de %d procesos (totales parciales)\n",
+                        procesos_sin_contadores, size);
+            }
+
+            fprintf(resumen, "\n=== Contadores por filtro ===\n");
+            for (int f = 0; f < N_FILTROS; f++) {
+                const long long* v = contadores + f * CAMPOS_FILTRO_HW;
+                double ipc = v[1 + HW_CICLOS] > 0 ? (double)v[1 + HW_INSTRUCCIONES] / v[1 + HW_CICLOS] : 0.0;
+                fprintf(resumen, "%s: llamadas %lld, tiempo %.6f s, instrucciones %lld, ciclos %lld, IPC %.3f, fallos de cache %lld\n",
+                        nombres_filtros[f], v[0], tiempos_filtro[f], v[1 + HW_INSTRUCCIONES], v[1 + HW_CICLOS], ipc,
+                        v[1 + HW_FALLOS_CACHE]);
+            }
+
+            fprintf(resumen, "\n=== Caché de resultados ===\n");
+            if (cache_activa) {
+                long long aciertos = 0, fallos = 0;
+                for (int f = 0; f <= FILTRO_BLUR; f++) {
+                    aciertos += cache_total[f];
+                    fallos += cache_total[N_FILTROS + f];
+                    fprintf(resumen, "%s: aciertos %lld, fallos %lld\n", nombres_filtros[f],
+                            cache_total[f], cache_total[N_FILTROS + f]);
+                }
+                fprintf(resumen, "Total: aciertos %lld, fallos %lld\n", aciertos, fallos);
+            } else {
+                fprintf(resumen, "Desactivada\n");
+            }
+
+            // Las fases de filtros concurrentes (hilos y procesos del mismo nodo) comparten
+            // el contador, así que lo muestreado por filtro se usa como proporción para
+            // repartir la energía de la corrida
+            fprintf(resumen, "\n=== Energía ===\n");
+            fprintf(resumen, "Fuente:");
+            for (int i = 0; i < ENERGIA_N_FUENTES; i++) {
+                if (fuentes[i] > 0) fprintf(resumen, " %s en %d procesos", fuentes_energia[i].nombre, fuentes[i]);
+            }
+            fprintf(resumen, "\n");
+            fprintf(resumen, "Energía total: %.3f J (%.6f kWh)\n", energia_total, energia_total / 3.6e6);
+            fprintf(resumen, "Energía por imagen: %.3f J\n", total > 0 ? energia_total / total : 0.0);
+            double muestreada = 0;
+            for (int f = 0; f < N_FILTROS; f++) muestreada += energia_filtro[f];
+            for (int f = 0; f < N_FILTROS; f++) {
+                const long long* v = contadores + f * CAMPOS_FILTRO_HW;
+                double joules = muestreada > 0 ? energia_total * energia_filtro[f] / muestreada : 0.0;
+                fprintf(resumen, "%s: %.3f J, %.6f J por llamada\n", nombres_filtros[f], joules,
+                        v[0] > 0 ? joules / v[0] : 0.0);
+            }
+
+            fprintf(resumen, "\n=== Memoria pico por proceso ===\n");
+            for (int r = 0; r < size; r++) {
+                fprintf(resumen, "Proceso %d: pool %.2f MB, RSS %.2f MB\n",
+                        r, memoria[2 * r] / 1048576.0, memoria[2 * r + 1] / 1048576.0);
+            }
             fclose(resumen);
         }
 
-	compare_execution_costs(tiempo_maximo);
+        for (int r = 0; r < size; r++) {
+            printf("Memoria pico proceso %d: pool %.2f MB, RSS %.2f MB\n",
+                   r, memoria[2 * r] / 1048576.0, memoria[2 * r + 1] / 1048576.0);
+        }
+        free(memoria);
+
+        char fuente[128] = "";
+        for (int i = 0; i < ENERGIA_N_FUENTES; i++) {
+            if (fuentes[i] == 0) continue;
+            if (fuente[0]) strncat(fuente, "+", sizeof(fuente) - strlen(fuente) - 1);
+            strncat(fuente, fuentes_energia[i].nombre, sizeof(fuente) - strlen(fuente) - 1);
+        }
+	compare_execution_costs(tiempo_maximo, energia_total, fuente);
         printf("Reporte generado correctamente por el proceso 0.\n");
     }
 
-    MPI_Finalize();
     return 0;
+}
+
+// Modo servicio (servicio.h): atiende trabajos por el socket hasta recibir "salir".
+int ejecutar_servicio(const char* ruta, int rank, int size, int hilo_mpi) {
+    int escucha = -1, ok = 1;
+    if (rank == 0) {
+        escucha = servicio_abrir(ruta);
+        ok = escucha >= 0;
+        if (ok) printf("Servicio escuchando en %s\n", ruta);
+        fflush(stdout);
+    }
+    MPI_Bcast(&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (!ok) return 1;
+
+    while (1) {
+        Trabajo t;
+        memset(&t, 0, sizeof(t));
+        if (rank == 0) {
+            while (1) {
+                int cliente = accept(escucha, NULL, NULL);
+                if (cliente < 0) {
+                    if (errno == EINTR) continue;
+                    perror("accept");
+                    t.comando = TRABAJO_SALIR;
+                    break;
+                }
+                char error[512];
+                eventos_usar_fd(cliente);
+                if (servicio_leer_pedido(cliente, &t, error, sizeof(error)) == 0) break;
+                eventos_error(error);
+                eventos_cerrar_canal();
+            }
+        }
+        servicio_difundir(&t, MPI_COMM_WORLD);
+
+        if (t.comando == TRABAJO_SALIR) {
+            if (rank == 0) {
+                eventos_fin(0, 0);
+                eventos_cerrar_canal();
+                close(escucha);
+                unlink(ruta);
+                printf("Servicio detenido.\n");
+            }
+            return 0;
+        }
+
+        if (rank == 0) {
+            printf("Trabajo recibido: carpeta %s, %d kernels, vista previa %d\n", t.carpeta, t.n_kernels, t.preview);
+            fflush(stdout);
+        }
+        if (ejecutar_trabajo(&t, rank, size, hilo_mpi) != 0 && rank == 0)
+            eventos_error("No se pudo leer la carpeta de entrada");
+        eventos_cerrar_canal();
+    }
+}
+
+int main(int argc, char** argv) {
+    int rank, size, hilo_mpi;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_SERIALIZED, &hilo_mpi);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // Hilos por proceso según CPUs, núcleos y nodos NUMA del host y cuántos procesos
+    // lo comparten (topologia.h)
+    configurar_hilos_por_topologia(MPI_COMM_WORLD);
+
+    // Medición de energía (energia.h): las fuentes que miden el nodo entero las cuenta
+    // solo el primer proceso de cada nodo
+    MPI_Comm nodo;
+    int rank_nodo;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &nodo);
+    MPI_Comm_rank(nodo, &rank_nodo);
+    MPI_Comm_free(&nodo);
+    energia_iniciar(rank_nodo == 0);
+
+    // "./main --servicio [socket]": el trabajo queda levantado atendiendo pedidos
+    if (argc >= 2 && strcmp(argv[1], "--servicio") == 0) {
+        const char* ruta = argc >= 3 ? argv[2] : getenv("FILTROS_SERVICIO");
+        if (!ruta || !ruta[0]) ruta = SERVICIO_RUTA_DEFECTO;
+        int resultado = ejecutar_servicio(ruta, rank, size, hilo_mpi);
+        eventos_finalizar();
+        MPI_Finalize();
+        return resultado;
+    }
+
+    // Uno o varios kernels (barrido): "./main 55 105 155" o "./main 55,105,155".
+    // Todos los blurs de una imagen se calculan juntos en blur_multi_img.
+    Trabajo t;
+    memset(&t, 0, sizeof(t));
+    t.comando = TRABAJO_PROCESAR;
+    t.filtros = TODOS_LOS_FILTROS;
+    snprintf(t.carpeta, sizeof(t.carpeta), "img");
+    if (rank == 0) {
+        if (argc < 2) {
+            printf("Error: se requiere el tamaño del kernel como argumento.\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+            return 1;
+        }
+
+        for (int a = 1; a < argc; a++) {
+            // "--preview n": vista previa sobre el nivel n de la pirámide (1/2, 1/4, 1/8)
+            if (strcmp(argv[a], "--preview") == 0 && a + 1 < argc) {
+                t.preview = atoi(argv[++a]);
+                if (t.preview < 0 || t.preview > PIRAMIDE_NIVELES) {
+                    printf("Nivel de vista previa inválido: %s. Se usa resolución completa.\n", argv[a]);
+                    t.preview = 0;
+                }
+                continue;
+            }
+            agregar_kernels(argv[a], t.kernels, &t.n_kernels);
+        }
+
+        if (t.n_kernels == 0) {
+            printf("Tamaño de kernel inválido. Se usará 105 por defecto.\n");
+            t.kernels[t.n_kernels++] = 105;
+        }
+
+        if (t.n_kernels == 1) {
+            printf("Kernel size recibido desde GUI: %d\n", t.kernels[0]);
+        } else {
+            printf("Barrido de %d kernels:", t.n_kernels);
+            for (int i = 0; i < t.n_kernels; i++) printf(" %d", t.kernels[i]);
+            printf("\n");
+        }
+    }
+
+    MPI_Bcast(&t, sizeof(Trabajo), MPI_BYTE, 0, MPI_COMM_WORLD);
+    if (rank == 0) printf("Procesando imágenes...\n");
+
+    int resultado = ejecutar_trabajo(&t, rank, size, hilo_mpi);
+    eventos_finalizar();
+    MPI_Finalize();
+    return resultado == 0 ? 0 : 1;
 }
\ No newline at end of file
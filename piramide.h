@@ -0,0 +1,145 @@
+// piramide.h
+#ifndef PIRAMIDE_H
+#define PIRAMIDE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include "bmp_io.h"
+#include "grises_simd.h"
+#include "filtros_img.h"
+
+// Pirámide de resolución para la vista previa: el nivel n es la imagen reducida a
+// 1/2^n por lado (1/2, 1/4, 1/8), cada uno promediando bloques de 2x2 del anterior.
+// Un nivel es un BMP completo en memoria (encabezado propio de 54 bytes + pixeles), así
+// que los filtros *_img lo procesan igual que una imagen cargada con cargar_bmp.
+//
+// El promedio se hace en dos pasos: la suma vertical de dos filas en enteros de 16 bits,
+// byte a byte sobre toda la fila (SSE2 en x86, 16 bytes por instrucción), y luego la suma
+// de cada par de pixeles vecinos de esa fila con redondeo: (a + b + c + d + 2) / 4.
+
+#define PIRAMIDE_NIVELES 3
+
+typedef struct {
+    ImagenBMP img;
+    unsigned char* buffer;      // encabezado + pixeles, del pool del hilo
+} NivelPiramide;
+
+// suma[i] = a[i] + b[i] para los n bytes de la fila
+void piramide_sumar_filas(const unsigned char* a, const unsigned char* b, unsigned short* suma, int n) {
+    int i = 0;
+#ifdef GRISES_X86
+    const __m128i cero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        _mm_storeu_si128((__m128i*)(suma + i), _mm_add_epi16(_mm_unpacklo_epi8(va, cero), _mm_unpacklo_epi8(vb, cero)));
+        _mm_storeu_si128((__m128i*)(suma + i + 8), _mm_add_epi16(_mm_unpackhi_epi8(va, cero), _mm_unpackhi_epi8(vb, cero)));
+    }
+#endif
+    for (; i < n; i++) suma[i] = a[i] + b[i];
+}
+
+// Una fila del nivel siguiente a partir de la suma vertical. Con ancho impar el último
+// pixel de salida promedia el último pixel de entrada consigo mismo.
+void piramide_fila(const unsigned short* suma, unsigned char* dst, int ancho_src, int ancho_dst) {
+    for (int x = 0; x < ancho_dst; x++) {
+        int x0 = 2 * x;
+        int x1 = x0 + 1 < ancho_src ? x0 + 1 : x0;
+        const unsigned short* p = suma + x0 * 3;
+        const unsigned short* q = suma + x1 * 3;
+        dst[x * 3 + 0] = (unsigned char)((p[0] + q[0] + 2) >> 2);
+        dst[x * 3 + 1] = (unsigned char)((p[1] + q[1] + 2) >> 2);
+        dst[x * 3 + 2] = (unsigned char)((p[2] + q[2] + 2) >> 2);
+    }
+}
+
+// Encabezado BMP de 24 bits para un nivel; la resolución se copia de la original
+void piramide_encabezado(unsigned char* h, const ImagenBMP* original, int ancho, int alto, size_t tam) {
+    memset(h, 0, 54);
+    h[0] = 'B';
+    h[1] = 'M';
+    *(int*)&h[2] = (int)(54 + tam);
+    *(int*)&h[10] = 54;
+    *(int*)&h[14] = 40;
+    *(int*)&h[18] = ancho;
+    *(int*)&h[22] = original->top_down ? -alto : alto;
+    *(short*)&h[26] = 1;
+    *(short*)&h[28] = 24;
+    *(int*)&h[34] = (int)tam;
+    memcpy(&h[38], &original->header[38], 8);
+}
+
+// Reduce src a la mitad por lado, redondeando hacia arriba: con lado impar la última
+// columna y la última fila se promedian consigo mismas en lugar de perderse.
+// Devuelve 0 si se pudo armar el nivel.
+int piramide_reducir(const ImagenBMP* src, NivelPiramide* nivel) {
+    memset(nivel, 0, sizeof(NivelPiramide));
+    int ancho = (src->ancho + 1) / 2;
+    int alto = (src->alto + 1) / 2;
+    int row_padded = (ancho * 3 + 3) & (~3);
+    size_t tam = (size_t)row_padded * alto;
+
+    nivel->buffer = (unsigned char*) pool_tomar(54 + tam);
+    if (!nivel->buffer) return -1;
+    piramide_encabezado(nivel->buffer, src, ancho, alto, tam);
+    if (parsear_encabezado_bmp(nivel->buffer, 54 + tam, "piramide", &nivel->img) != 0) {
+        pool_devolver(nivel->buffer);
+        nivel->buffer = NULL;
+        return -1;
+    }
+    nivel->img.header = nivel->buffer;
+    nivel->img.data = nivel->buffer + 54;
+    nivel->img.tam_mapa = 54 + tam;
+
+    unsigned char* dst = nivel->buffer + 54;
+    int n_src = src->ancho * 3;
+
+    #pragma omp parallel if(paralelo_interno(src->ancho, src->alto))
+    {
+        unsigned short* suma = (unsigned short*) pool_tomar((size_t)n_src * sizeof(unsigned short));
+        #pragma omp for schedule(static)
+        for (int y = 0; y < alto; y++) {
+            int y0 = 2 * y;
+            int y1 = y0 + 1 < src->alto ? y0 + 1 : y0;
+            piramide_sumar_filas(src->data + (size_t)y0 * src->row_padded, src->data + (size_t)y1 * src->row_padded,
+                                 suma, n_src);
+            unsigned char* fila = dst + (size_t)y * row_padded;
+            piramide_fila(suma, fila, src->ancho, ancho);
+            memset(fila + ancho * 3, 0, row_padded - ancho * 3);
+        }
+        pool_devolver(suma);
+    }
+    return 0;
+}
+
+void piramide_liberar(NivelPiramide* nivel) {
+    if (nivel->buffer) pool_devolver(nivel->buffer);
+    memset(nivel, 0, sizeof(NivelPiramide));
+}
+
+// Arma el nivel `n` (1..PIRAMIDE_NIVELES) reduciendo nivel por nivel desde la original;
+// los intermedios se liberan en el camino.
+int piramide_nivel(const ImagenBMP* original, int n, NivelPiramide* nivel) {
+    NivelPiramide actual, siguiente;
+    if (piramide_reducir(original, &actual) != 0) return -1;
+    for (int i = 1; i < n; i++) {
+        int ok = piramide_reducir(&actual.img, &siguiente);
+        piramide_liberar(&actual);
+        if (ok != 0) return -1;
+        actual = siguiente;
+    }
+    *nivel = actual;
+    return 0;
+}
+
+// Kernel equivalente en el nivel n: el radio se escala por 1/2^n, redondeado y de al
+// menos 1, así la vista previa se ve como la salida final reducida.
+int piramide_kernel(int kernel, int n) {
+    int radio = ((kernel / 2) + (1 << (n - 1))) >> n;
+    if (radio < 1) radio = 1;
+    return 2 * radio + 1;
+}
+
+#endif
@@ -0,0 +1,101 @@
+// pool_buffers.h
+#ifndef POOL_BUFFERS_H
+#define POOL_BUFFERS_H
+
+#include <stdlib.h>
+
+// Pool de buffers por hilo para la memoria de trabajo de los filtros (buffers de
+// pixeles, temporales del blur). Cada hilo conserva sus buffers entre imágenes, así
+// que con imágenes de tamaño parecido no se vuelve a pedir memoria al sistema.
+// Un buffer se devuelve desde el mismo hilo que lo tomó.
+
+#define POOL_RANURAS 8
+#define POOL_MAX_RETENIDO ((size_t)256 << 20)   // buffers más grandes se liberan al devolverlos
+#define POOL_ENCABEZADO 16                       // tamaño guardado delante de los buffers fuera del pool
+
+typedef struct {
+    unsigned char* buf[POOL_RANURAS];
+    size_t cap[POOL_RANURAS];
+    int en_uso[POOL_RANURAS];
+} PoolHilo;
+
+__thread PoolHilo pool_hilo;
+
+// Bytes reservados por los pools de todos los hilos del proceso (incluidos los buffers
+// pedidos fuera del pool con las ranuras llenas) y su máximo desde pool_reiniciar_pico
+long long pool_bytes_reservados = 0;
+long long pool_bytes_pico = 0;
+
+void pool_contar(long long delta) {
+    long long actual = __atomic_add_fetch(&pool_bytes_reservados, delta, __ATOMIC_RELAXED);
+    long long pico = __atomic_load_n(&pool_bytes_pico, __ATOMIC_RELAXED);
+    while (actual > pico &&
+           !__atomic_compare_exchange_n(&pool_bytes_pico, &pico, actual, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+void* pool_tomar(size_t bytes) {
+    PoolHilo* p = &pool_hilo;
+    int mejor = -1, crecer = -1;
+
+    // El buffer libre más chico que alcance; si ninguno alcanza, se agranda el libre más grande
+    for (int i = 0; i < POOL_RANURAS; i++) {
+        if (p->en_uso[i]) continue;
+        if (p->cap[i] >= bytes && (mejor < 0 || p->cap[i] < p->cap[mejor])) mejor = i;
+        if (crecer < 0 || p->cap[i] > p->cap[crecer]) crecer = i;
+    }
+
+    if (mejor < 0) {
+        // Todas las ranuras ocupadas: fuera del pool, con el tamaño delante para descontarlo
+        if (crecer < 0) {
+            unsigned char* b = (unsigned char*) malloc(POOL_ENCABEZADO + bytes);
+            if (!b) return NULL;
+            *(size_t*)b = bytes;
+            pool_contar((long long)bytes);
+            return b + POOL_ENCABEZADO;
+        }
+
+        size_t cap = bytes + bytes / 8;
+        free(p->buf[crecer]);
+        pool_contar(-(long long)p->cap[crecer]);
+        p->buf[crecer] = (unsigned char*) malloc(cap);
+        p->cap[crecer] = p->buf[crecer] ? cap : 0;
+        pool_contar((long long)p->cap[crecer]);
+        if (!p->buf[crecer]) return NULL;
+        mejor = crecer;
+    }
+
+    p->en_uso[mejor] = 1;
+    return p->buf[mejor];
+}
+
+void pool_devolver(void* ptr) {
+    if (!ptr) return;
+    PoolHilo* p = &pool_hilo;
+
+    for (int i = 0; i < POOL_RANURAS; i++) {
+        if (p->buf[i] != ptr) continue;
+        p->en_uso[i] = 0;
+        if (p->cap[i] > POOL_MAX_RETENIDO) {
+            free(p->buf[i]);
+            pool_contar(-(long long)p->cap[i]);
+            p->buf[i] = NULL;
+            p->cap[i] = 0;
+        }
+        return;
+    }
+    unsigned char* b = (unsigned char*)ptr - POOL_ENCABEZADO;
+    pool_contar(-(long long)*(size_t*)b);
+    free(b);
+}
+
+long long pool_memoria_pico() {
+    return __atomic_load_n(&pool_bytes_pico, __ATOMIC_RELAXED);
+}
+
+// El pico vuelve a lo reservado ahora (los pools conservan sus buffers entre trabajos)
+void pool_reiniciar_pico() {
+    __atomic_store_n(&pool_bytes_pico, __atomic_load_n(&pool_bytes_reservados, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+}
+
+#endif
@@ -0,0 +1,253 @@
+// reparto_mpi.h
+#ifndef REPARTO_MPI_H
+#define REPARTO_MPI_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <omp.h>
+#include <mpi.h>
+#include "eventos.h"
+
+// Reparto dinámico de imágenes entre procesos MPI (maestro/trabajador).
+//
+// El proceso 0 mantiene una cola ordenada de mayor a menor tamaño de archivo y la
+// atiende desde un hilo despachador; los demás procesos piden lotes conforme se
+// desocupan y avisan cada imagen terminada. El proceso 0 también procesa imágenes
+// tomando de la misma cola. Los lotes se achican conforme se vacía la cola (estilo
+// guided), así el final de la corrida queda balanceado entre nodos rápidos y lentos.
+// Cada aviso de imagen terminada lleva además los eventos de progreso pendientes del
+// proceso (eventos.h), así el proceso 0 los recibe sin mensajes extra.
+
+#define TAG_PEDIDO 1
+#define TAG_LOTE 2
+#define TAG_TERMINADA 3
+#define MAX_LOTE 64
+
+typedef void (*procesar_lote_fn)(const int* lote, int n, void* ctx);
+
+typedef struct {
+    int* orden;                 // índices de imágenes, de mayor a menor tamaño
+    const long long* tamanos;
+    int total;
+    int siguiente;
+    long long bytes_restantes;
+    int procesos;
+    pthread_mutex_t mutex;
+} ColaImagenes;
+
+// Estado del proceso para reportar imágenes terminadas
+int reparto_rank = 0;
+int reparto_remoto = 0;         // 1 si los reportes van por MPI al proceso 0
+char** reparto_nombres = NULL;
+pthread_mutex_t reparto_salida = PTHREAD_MUTEX_INITIALIZER;
+// Serializa las llamadas MPI de los trabajadores: los avisos de imagen terminada salen
+// de los hilos escritores mientras el hilo principal pide lotes.
+pthread_mutex_t reparto_mpi = PTHREAD_MUTEX_INITIALIZER;
+
+const long long* cola_tamanos_orden = NULL;
+
+int comparar_por_tamano(const void* a, const void* b) {
+    long long ta = cola_tamanos_orden[*(const int*)a];
+    long long tb = cola_tamanos_orden[*(const int*)b];
+    if (ta != tb) return ta < tb ? 1 : -1;
+    return *(const int*)a - *(const int*)b;
+}
+
+void cola_iniciar(ColaImagenes* cola, const long long* tamanos, int total, int procesos) {
+    cola->orden = (int*) malloc((total > 0 ? total : 1) * sizeof(int));
+    cola->tamanos = tamanos;
+    cola->total = total;
+    cola->siguiente = 0;
+    cola->bytes_restantes = 0;
+    cola->procesos = procesos;
+    pthread_mutex_init(&cola->mutex, NULL);
+
+    for (int i = 0; i < total; i++) {
+        cola->orden[i] = i;
+        cola->bytes_restantes += tamanos[i];
+    }
+    cola_tamanos_orden = tamanos;
+    qsort(cola->orden, total, sizeof(int), comparar_por_tamano);
+}
+
+void cola_liberar(ColaImagenes* cola) {
+    pthread_mutex_destroy(&cola->mutex);
+    free(cola->orden);
+}
+
+// Toma hasta `capacidad` imágenes. El lote se corta cuando supera la fracción
+// bytes_restantes / (2 * procesos), pero siempre lleva al menos una imagen.
+int cola_tomar_lote(ColaImagenes* cola, int capacidad, int* lote) {
+    if (capacidad > MAX_LOTE) capacidad = MAX_LOTE;
+
+    pthread_mutex_lock(&cola->mutex);
+    long long objetivo = cola->bytes_restantes / (2LL * cola->procesos);
+    long long bytes_lote = 0;
+    int n = 0;
+
+    while (n < capacidad && cola->siguiente < cola->total) {
+        int idx = cola->orden[cola->siguiente];
+        long long t = cola->tamanos[idx];
+        if (n > 0 && bytes_lote + t > objetivo) break;
+        lote[n++] = idx;
+        bytes_lote += t;
+        cola->siguiente++;
+    }
+    cola->bytes_restantes -= bytes_lote;
+    pthread_mutex_unlock(&cola->mutex);
+    return n;
+}
+
+void reparto_imprimir_terminada(int indice, int proceso, double segundos) {
+    const char* ruta = reparto_nombres[indice];
+    const char* nombre = strrchr(ruta, '/');
+
+    pthread_mutex_lock(&reparto_salida);
+    printf("Imagen terminada: %s (proceso %d, %.3f s)\n", nombre ? nombre + 1 : ruta, proceso, segundos);
+    fflush(stdout);
+    pthread_mutex_unlock(&reparto_salida);
+    eventos_imagen_terminada(ruta, proceso, segundos);
+}
+
+// Mensaje de imagen terminada: índice y segundos, seguidos de los eventos pendientes
+typedef struct {
+    double indice;
+    double segundos;
+} AvisoTerminada;
+
+// Avisa que una imagen terminó. Se puede llamar desde cualquier hilo.
+void reparto_terminada(int indice, double segundos) {
+    int n;
+    EventoProgreso* eventos = eventos_recolectar(&n);
+
+    if (reparto_remoto) {
+        size_t bytes = sizeof(AvisoTerminada) + (size_t)n * sizeof(EventoProgreso);
+        char* msg = (char*) malloc(bytes);
+        AvisoTerminada aviso = { (double)indice, segundos };
+        memcpy(msg, &aviso, sizeof(aviso));
+        if (n > 0) memcpy(msg + sizeof(aviso), eventos, (size_t)n * sizeof(EventoProgreso));
+        pthread_mutex_lock(&reparto_mpi);
+        MPI_Send(msg, (int) bytes, MPI_BYTE, 0, TAG_TERMINADA, MPI_COMM_WORLD);
+        pthread_mutex_unlock(&reparto_mpi);
+        free(msg);
+    } else {
+        eventos_emitir(eventos, n, reparto_rank, reparto_nombres);
+        reparto_imprimir_terminada(indice, reparto_rank, segundos);
+    }
+    free(eventos);
+}
+
+// Hilo despachador del proceso 0: atiende pedidos de lotes y avisos de imágenes
+// terminadas hasta que todos los trabajadores recibieron el lote vacío y reportaron.
+void* despachador(void* arg) {
+    ColaImagenes* cola = (ColaImagenes*) arg;
+    int activos = cola->procesos - 1;
+    int asignadas = 0, recibidas = 0;
+    int buf[MAX_LOTE + 1];
+    struct timespec espera = { 0, 200000 };
+    double ultimo_vaciado = omp_get_wtime();
+
+    while (activos > 0 || recibidas < asignadas) {
+        int hay;
+        MPI_Status st;
+        MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &hay, &st);
+        if (!hay) {
+            // Los eventos del propio proceso 0 salen cada 100 ms aunque no termine ninguna imagen
+            if (eventos_activos && omp_get_wtime() - ultimo_vaciado > 0.1) {
+                eventos_vaciar_local(0, reparto_nombres);
+                ultimo_vaciado = omp_get_wtime();
+            }
+            nanosleep(&espera, NULL);
+            continue;
+        }
+
+        if (st.MPI_TAG == TAG_PEDIDO) {
+            int capacidad;
+            MPI_Recv(&capacidad, 1, MPI_INT, st.MPI_SOURCE, TAG_PEDIDO, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            buf[0] = cola_tomar_lote(cola, capacidad, buf + 1);
+            MPI_Send(buf, buf[0] + 1, MPI_INT, st.MPI_SOURCE, TAG_LOTE, MPI_COMM_WORLD);
+            if (buf[0] == 0) activos--;
+            asignadas += buf[0];
+        } else if (st.MPI_TAG == TAG_TERMINADA) {
+            int bytes;
+            MPI_Get_count(&st, MPI_BYTE, &bytes);
+            char* msg = (char*) malloc(bytes);
+            MPI_Recv(msg, bytes, MPI_BYTE, st.MPI_SOURCE, TAG_TERMINADA, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            recibidas++;
+            AvisoTerminada aviso;
+            memcpy(&aviso, msg, sizeof(aviso));
+            int n = (bytes - (int)sizeof(aviso)) / (int)sizeof(EventoProgreso);
+            EventoProgreso* eventos = n > 0 ? (EventoProgreso*) malloc(n * sizeof(EventoProgreso)) : NULL;
+            if (n > 0) memcpy(eventos, msg + sizeof(aviso), n * sizeof(EventoProgreso));
+            eventos_emitir(eventos, n, st.MPI_SOURCE, reparto_nombres);
+            reparto_imprimir_terminada((int)aviso.indice, st.MPI_SOURCE, aviso.segundos);
+            free(eventos);
+            free(msg);
+        } else {
+            fprintf(stderr, "[ERROR] Mensaje inesperado con tag %d del proceso %d\n", st.MPI_TAG, st.MPI_SOURCE);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    return NULL;
+}
+
+// Reparte las imágenes entre todos los procesos. `hilo_mpi` es el nivel de soporte de
+// hilos que dio MPI_Init_thread: sin MPI_THREAD_SERIALIZED se usa el reparto estático
+// por rank (i = rank; i += size) de antes.
+void reparto_dinamico(char** nombres, const long long* tamanos, int total, int rank, int size, int hilo_mpi,
+                      procesar_lote_fn procesar, void* ctx) {
+    int capacidad = omp_get_max_threads();
+    int lote[MAX_LOTE];
+
+    reparto_rank = rank;
+    reparto_nombres = nombres;
+
+    if (hilo_mpi < MPI_THREAD_SERIALIZED) {
+        if (rank == 0) printf("MPI sin soporte de hilos; se usa reparto estático.\n");
+        reparto_remoto = 0;
+        int n = 0;
+        for (int i = rank; i < total; i += size) {
+            lote[n++] = i;
+            if (n == MAX_LOTE) {
+                procesar(lote, n, ctx);
+                n = 0;
+            }
+        }
+        if (n > 0) procesar(lote, n, ctx);
+        return;
+    }
+
+    if (rank != 0) {
+        reparto_remoto = 1;
+        int buf[MAX_LOTE + 1];
+        while (1) {
+            pthread_mutex_lock(&reparto_mpi);
+            MPI_Send(&capacidad, 1, MPI_INT, 0, TAG_PEDIDO, MPI_COMM_WORLD);
+            MPI_Recv(buf, MAX_LOTE + 1, MPI_INT, 0, TAG_LOTE, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            pthread_mutex_unlock(&reparto_mpi);
+            if (buf[0] == 0) break;
+            procesar(buf + 1, buf[0], ctx);
+        }
+        return;
+    }
+
+    reparto_remoto = 0;
+    ColaImagenes cola;
+    cola_iniciar(&cola, tamanos, total, size);
+
+    pthread_t hilo;
+    if (size > 1) pthread_create(&hilo, NULL, despachador, &cola);
+
+    int n;
+    while ((n = cola_tomar_lote(&cola, capacidad, lote)) > 0) {
+        procesar(lote, n, ctx);
+    }
+
+    if (size > 1) pthread_join(hilo, NULL);
+    cola_liberar(&cola);
+}
+
+#endif
@@ -0,0 +1,203 @@
+// servicio.h
+#ifndef SERVICIO_H
+#define SERVICIO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <mpi.h>
+#include "contadores_hw.h"
+#include "filtros_img.h"
+#include "piramide.h"
+
+// Modo servicio: el trabajo MPI queda levantado y recibe trabajos por un socket Unix
+// local, sin pagar en cada corrida el arranque de MPI, la configuración de hilos ni
+// el calentamiento del pool de buffers y la caché.
+//
+// Protocolo: el cliente se conecta y manda líneas "clave=valor" terminadas con una
+// línea vacía (o cerrando su lado de escritura):
+//   carpeta=/ruta/de/entrada     (por defecto img)
+//   kernels=55,105               (por defecto 105)
+//   filtros=grises,blur,...      (nombres de nombres_filtros o "todos", por defecto todos)
+//   preview=2                    (vista previa sobre el nivel 1..3 de la pirámide, piramide.h)
+//   comando=salir                (detiene el servicio)
+// La respuesta son los eventos de progreso del trabajo (eventos.h) en la misma
+// conexión, terminando con el registro "fin" o "error"; después se cierra. Un cliente que
+// no termina el pedido en SERVICIO_ESPERA_PEDIDO segundos, o que pide una carpeta que no
+// existe, recibe un "error" y el servicio sigue atendiendo a los demás.
+
+#define SERVICIO_RUTA_DEFECTO "/tmp/filtros_servicio.sock"
+#define SERVICIO_ESPERA_PEDIDO 5
+#define TRABAJO_PROCESAR 0
+#define TRABAJO_SALIR 1
+#define TODOS_LOS_FILTROS ((1 << (FILTRO_BLUR + 1)) - 1)
+
+// Trabajo a procesar: en una corrida normal sale de los argumentos; en el modo servicio
+// llega por el socket y el proceso 0 lo difunde a los demás.
+typedef struct {
+    int comando;
+    int filtros;                        // bit f: generar el filtro f (FILTRO_GRISES ... FILTRO_BLUR)
+    int preview;                        // 0: resolución completa; n: nivel n de la pirámide
+    int n_kernels;
+    int kernels[MAX_KERNELS_BLUR];
+    char carpeta[1024];
+} Trabajo;
+
+// Agrega los kernels de una lista separada por comas. Se ignoran los inválidos y los
+// repetidos; a lo sumo MAX_KERNELS_BLUR.
+void agregar_kernels(const char* texto, int* kernels, int* n_kernels) {
+    char lista[256];
+    snprintf(lista, sizeof(lista), "%s", texto);
+    char* resto = NULL;
+    for (char* tok = strtok_r(lista, ",", &resto); tok; tok = strtok_r(NULL, ",", &resto)) {
+        int k = atoi(tok);
+        if (k < 55 || k > 155 || k % 2 == 0) {
+            printf("Tamaño de kernel inválido: %s. Se ignora.\n", tok);
+            continue;
+        }
+        int repetido = 0;
+        for (int i = 0; i < *n_kernels; i++) repetido |= kernels[i] == k;
+        if (repetido) continue;
+        if (*n_kernels == MAX_KERNELS_BLUR) {
+            printf("Se aceptan hasta %d kernels; se ignora %d.\n", MAX_KERNELS_BLUR, k);
+            continue;
+        }
+        kernels[(*n_kernels)++] = k;
+    }
+}
+
+// Máscara de filtros a partir de "grises,blur,..."; -1 si algún nombre no existe
+int parsear_filtros(const char* texto) {
+    char lista[256];
+    snprintf(lista, sizeof(lista), "%s", texto);
+    int mascara = 0;
+    char* resto = NULL;
+    for (char* tok = strtok_r(lista, ",", &resto); tok; tok = strtok_r(NULL, ",", &resto)) {
+        if (strcmp(tok, "todos") == 0) {
+            mascara |= TODOS_LOS_FILTROS;
+            continue;
+        }
+        int f = 0;
+        while (f <= FILTRO_BLUR && strcmp(tok, nombres_filtros[f]) != 0) f++;
+        if (f > FILTRO_BLUR) return -1;
+        mascara |= 1 << f;
+    }
+    return mascara;
+}
+
+int servicio_abrir(const char* ruta) {
+    struct sockaddr_un dir;
+    memset(&dir, 0, sizeof(dir));
+    dir.sun_family = AF_UNIX;
+    if (strlen(ruta) >= sizeof(dir.sun_path)) {
+        fprintf(stderr, "Ruta de socket demasiado larga: %s\n", ruta);
+        return -1;
+    }
+    snprintf(dir.sun_path, sizeof(dir.sun_path), "%s", ruta);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    unlink(ruta);
+    if (bind(fd, (struct sockaddr*) &dir, sizeof(dir)) != 0 || listen(fd, 8) != 0) {
+        perror("No se pudo abrir el socket del servicio");
+        close(fd);
+        return -1;
+    }
+    chmod(ruta, 0600);
+    return fd;
+}
+
+// Lee el pedido de un cliente. Devuelve 0 si es válido; si no, deja el motivo en `error`.
+int servicio_leer_pedido(int cliente, Trabajo* t, char* error, size_t tam_error) {
+    memset(t, 0, sizeof(Trabajo));
+    t->comando = TRABAJO_PROCESAR;
+    t->filtros = TODOS_LOS_FILTROS;
+    snprintf(t->carpeta, sizeof(t->carpeta), "img");
+
+    // Un pedido es corto: se acumula hasta la línea vacía o el fin de la conexión. Con
+    // el plazo de lectura, un cliente que se queda callado no bloquea el servicio.
+    struct timeval plazo = { SERVICIO_ESPERA_PEDIDO, 0 };
+    setsockopt(cliente, SOL_SOCKET, SO_RCVTIMEO, &plazo, sizeof(plazo));
+
+    char buf[8192];
+    size_t n = 0;
+    while (n < sizeof(buf) - 1) {
+        ssize_t r = read(cliente, buf + n, sizeof(buf) - 1 - n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            snprintf(error, tam_error, "El pedido no llegó completo en %d s", SERVICIO_ESPERA_PEDIDO);
+            return -1;
+        }
+        if (r <= 0) break;
+        n += r;
+        buf[n] = '\0';
+        if (strstr(buf, "\n\n")) break;
+    }
+    buf[n] = '\0';
+
+    char* resto = NULL;
+    for (char* linea = strtok_r(buf, "\n", &resto); linea; linea = strtok_r(NULL, "\n", &resto)) {
+        size_t largo = strlen(linea);
+        if (largo > 0 && linea[largo - 1] == '\r') linea[--largo] = '\0';
+        char* igual = strchr(linea, '=');
+        if (!igual) continue;
+        *igual = '\0';
+        const char* valor = igual + 1;
+
+        if (strcmp(linea, "carpeta") == 0) {
+            snprintf(t->carpeta, sizeof(t->carpeta), "%s", valor);
+        } else if (strcmp(linea, "kernels") == 0) {
+            agregar_kernels(valor, t->kernels, &t->n_kernels);
+        } else if (strcmp(linea, "filtros") == 0) {
+            t->filtros = parsear_filtros(valor);
+            if (t->filtros <= 0) {
+                snprintf(error, tam_error, "Filtros inválidos: %s", valor);
+                return -1;
+            }
+        } else if (strcmp(linea, "preview") == 0) {
+            t->preview = atoi(valor);
+            if (t->preview < 0 || t->preview > PIRAMIDE_NIVELES) {
+                snprintf(error, tam_error, "Nivel de vista previa inválido: %s (0 a %d)", valor, PIRAMIDE_NIVELES);
+                return -1;
+            }
+        } else if (strcmp(linea, "comando") == 0) {
+            if (strcmp(valor, "salir") == 0) t->comando = TRABAJO_SALIR;
+        }
+    }
+
+    if (t->n_kernels == 0) t->kernels[t->n_kernels++] = 105;
+
+    // Con FILTROS_MANIFIESTO la lista no sale de la carpeta (lista_imagenes.h)
+    const char* manifiesto = getenv("FILTROS_MANIFIESTO");
+    struct stat st;
+    if (t->comando == TRABAJO_PROCESAR && !(manifiesto && manifiesto[0]) &&
+        (stat(t->carpeta, &st) != 0 || !S_ISDIR(st.st_mode))) {
+        snprintf(error, tam_error, "La carpeta de entrada no existe o no es un directorio: %s", t->carpeta);
+        return -1;
+    }
+    return 0;
+}
+
+// Colectiva: difunde el trabajo desde el proceso 0. Mientras el servicio está ocioso,
+// los demás procesos esperan con MPI_Test y pausas en lugar de ocupar una CPU
+// esperando activamente dentro de MPI_Bcast.
+void servicio_difundir(Trabajo* t, MPI_Comm comm) {
+    MPI_Request req;
+    MPI_Ibcast(t, sizeof(Trabajo), MPI_BYTE, 0, comm, &req);
+    struct timespec espera = { 0, 1000000 };
+    int listo = 0;
+    while (1) {
+        MPI_Test(&req, &listo, MPI_STATUS_IGNORE);
+        if (listo) break;
+        nanosleep(&espera, NULL);
+    }
+}
+
+#endif
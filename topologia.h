@@ -0,0 +1,329 @@
+// topologia.h
+#ifndef TOPOLOGIA_H
+#define TOPOLOGIA_H
+
+// Necesita _GNU_SOURCE (sched_getaffinity, pthread_setaffinity_np) definido antes del
+// primer include de la unidad de compilación; main.c lo define al principio.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <omp.h>
+#include <mpi.h>
+#include "filtros_img.h"
+
+// Configuración de hilos según la topología del nodo, en lugar de una tabla por hostname.
+//
+// Se leen de sysfs las CPUs de la máscara de afinidad del proceso, su núcleo físico y su
+// nodo NUMA. Si el lanzador no fijó afinidad por proceso, las CPUs del nodo se reparten
+// entre los procesos MPI que lo comparten en bloques contiguos (ordenados por nodo NUMA
+// y núcleo, así los hermanos SMT quedan juntos). Cada hilo OpenMP se fija a una CPU de
+// su bloque; el hilo principal queda con el bloque completo para que los hilos que crea
+// (escritores, despachador) no compartan CPU con el hilo 0.
+//
+// Cantidad de hilos, en orden de prioridad:
+//   FILTROS_HILOS=n u OMP_NUM_THREADS=n
+//   FILTROS_CALIBRAR=1: mide en el nodo varias opciones, usa la mejor y la guarda
+//   la entrada de filtros_hilos.conf para este host y procesos por nodo
+//   una por CPU del bloque del proceso
+// FILTROS_CONFIG_HILOS cambia el archivo (./filtros_hilos.conf por defecto); cada línea
+// es "host procesos_por_nodo hilos". FILTROS_PINNING=0 desactiva la fijación de hilos.
+
+#define TOPOLOGIA_MAX_CPUS CPU_SETSIZE
+
+typedef struct {
+    int n_cpus;                         // CPUs de la máscara de afinidad
+    int cpus[TOPOLOGIA_MAX_CPUS];       // ordenadas por nodo NUMA, paquete y núcleo
+    int nucleos;                        // núcleos físicos distintos en la máscara
+    int hilos_por_nucleo;
+    int nodos_numa;
+    int procesos_nodo;                  // procesos MPI en el mismo nodo
+    int rank_nodo;
+    int bloque_inicio;                  // CPUs de este proceso: cpus[bloque_inicio ...]
+    int bloque_cpus;
+} TopologiaNodo;
+
+typedef struct {
+    int cpu;
+    int numa;
+    int paquete;
+    int nucleo;
+} CpuSysfs;
+
+int leer_entero_sysfs(const char* ruta, int defecto) {
+    FILE* f = fopen(ruta, "r");
+    if (!f) return defecto;
+    int v;
+    if (fscanf(f, "%d", &v) != 1) v = defecto;
+    fclose(f);
+    return v;
+}
+
+// El nodo NUMA de una CPU aparece como un enlace nodeN dentro de su directorio
+int nodo_numa_cpu(int cpu) {
+    char ruta[128];
+    snprintf(ruta, sizeof(ruta), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR* dir = opendir(ruta);
+    if (!dir) return 0;
+    int nodo = 0;
+    struct dirent* e;
+    while ((e = readdir(dir))) {
+        if (strncmp(e->d_name, "node", 4) == 0 && e->d_name[4] >= '0' && e->d_name[4] <= '9') {
+            nodo = atoi(e->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return nodo;
+}
+
+int comparar_cpus(const void* a, const void* b) {
+    const CpuSysfs* x = (const CpuSysfs*) a;
+    const CpuSysfs* y = (const CpuSysfs*) b;
+    if (x->numa != y->numa) return x->numa - y->numa;
+    if (x->paquete != y->paquete) return x->paquete - y->paquete;
+    if (x->nucleo != y->nucleo) return x->nucleo - y->nucleo;
+    return x->cpu - y->cpu;
+}
+
+void topologia_leer(TopologiaNodo* t) {
+    memset(t, 0, sizeof(TopologiaNodo));
+    cpu_set_t mascara;
+    CPU_ZERO(&mascara);
+    if (sched_getaffinity(0, sizeof(mascara), &mascara) != 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int c = 0; c < n && c < TOPOLOGIA_MAX_CPUS; c++) CPU_SET(c, &mascara);
+    }
+
+    CpuSysfs* info = (CpuSysfs*) malloc(TOPOLOGIA_MAX_CPUS * sizeof(CpuSysfs));
+    int n = 0;
+    for (int c = 0; c < TOPOLOGIA_MAX_CPUS; c++) {
+        if (!CPU_ISSET(c, &mascara)) continue;
+        char ruta[128];
+        info[n].cpu = c;
+        snprintf(ruta, sizeof(ruta), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", c);
+        info[n].paquete = leer_entero_sysfs(ruta, 0);
+        snprintf(ruta, sizeof(ruta), "/sys/devices/system/cpu/cpu%d/topology/core_id", c);
+        info[n].nucleo = leer_entero_sysfs(ruta, c);
+        info[n].numa = nodo_numa_cpu(c);
+        n++;
+    }
+    qsort(info, n, sizeof(CpuSysfs), comparar_cpus);
+
+    t->n_cpus = n;
+    for (int i = 0; i < n; i++) {
+        t->cpus[i] = info[i].cpu;
+        int nuevo_nucleo = i == 0 || info[i].nucleo != info[i - 1].nucleo || info[i].paquete != info[i - 1].paquete ||
+                           info[i].numa != info[i - 1].numa;
+        int nuevo_numa = i == 0 || info[i].numa != info[i - 1].numa;
+        t->nucleos += nuevo_nucleo;
+        t->nodos_numa += nuevo_numa;
+    }
+    t->hilos_por_nucleo = t->nucleos > 0 ? (n + t->nucleos - 1) / t->nucleos : 1;
+    free(info);
+}
+
+// Colectiva: averigua cuántos procesos comparten el nodo y qué bloque de CPUs le toca a
+// cada uno. Si las máscaras difieren, el lanzador ya fijó afinidad y se respeta.
+void topologia_repartir(TopologiaNodo* t, MPI_Comm comm, MPI_Comm* nodo) {
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, nodo);
+    MPI_Comm_size(*nodo, &t->procesos_nodo);
+    MPI_Comm_rank(*nodo, &t->rank_nodo);
+
+    long long firma = t->n_cpus;
+    for (int i = 0; i < t->n_cpus; i++) firma = firma * 1000003LL + t->cpus[i];
+    long long minima, maxima;
+    MPI_Allreduce(&firma, &minima, 1, MPI_LONG_LONG, MPI_MIN, *nodo);
+    MPI_Allreduce(&firma, &maxima, 1, MPI_LONG_LONG, MPI_MAX, *nodo);
+
+    t->bloque_inicio = 0;
+    t->bloque_cpus = t->n_cpus;
+    if (minima == maxima && t->procesos_nodo > 1) {
+        int p = t->procesos_nodo, r = t->rank_nodo;
+        if (p <= t->n_cpus) {
+            t->bloque_inicio = (int)((long long)t->n_cpus * r / p);
+            t->bloque_cpus = (int)((long long)t->n_cpus * (r + 1) / p) - t->bloque_inicio;
+        } else {
+            // Más procesos que CPUs: se comparten de a una
+            t->bloque_inicio = r % t->n_cpus;
+            t->bloque_cpus = 1;
+        }
+    }
+}
+
+int pinning_activo() {
+    const char* env = getenv("FILTROS_PINNING");
+    return !(env && strcmp(env, "0") == 0);
+}
+
+// Fija los hilos 1..n-1 del equipo OpenMP a CPUs repartidas en el bloque y deja al hilo 0
+// con el bloque completo.
+void topologia_fijar_hilos(const TopologiaNodo* t, int hilos) {
+    if (!pinning_activo() || t->bloque_cpus <= 0) return;
+    const int* bloque = t->cpus + t->bloque_inicio;
+    int m = t->bloque_cpus;
+
+    #pragma omp parallel num_threads(hilos)
+    {
+        int h = omp_get_thread_num();
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        if (h == 0) {
+            for (int i = 0; i < m; i++) CPU_SET(bloque[i], &cpus);
+        } else {
+            CPU_SET(bloque[(int)((long long)h * m / hilos) % m], &cpus);
+        }
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+}
+
+const char* ruta_config_hilos() {
+    const char* env = getenv("FILTROS_CONFIG_HILOS");
+    return env && env[0] ? env : "./filtros_hilos.conf";
+}
+
+int config_hilos_leer(const char* host, int procesos_nodo) {
+    FILE* f = fopen(ruta_config_hilos(), "r");
+    if (!f) return 0;
+    char linea[512], h[256];
+    int p, hilos, encontrado = 0;
+    while (fgets(linea, sizeof(linea), f)) {
+        if (linea[0] == '#') continue;
+        if (sscanf(linea, "%255s %d %d", h, &p, &hilos) == 3 && strcmp(h, host) == 0 && p == procesos_nodo && hilos > 0)
+            encontrado = hilos;
+    }
+    fclose(f);
+    return encontrado;
+}
+
+// Reemplaza (o agrega) la línea de este host. Varios nodos pueden escribir a la vez
+// sobre un archivo compartido: se toma un flock mientras se reescribe.
+void config_hilos_guardar(const char* host, int procesos_nodo, int hilos) {
+    int fd = open(ruta_config_hilos(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return;
+    flock(fd, LOCK_EX);
+
+    FILE* f = fdopen(fd, "r+");
+    size_t cap = 4096, largo = 0;
+    char* nuevo = (char*) malloc(cap);
+    char linea[512], h[256];
+    int p, hl;
+    while (fgets(linea, sizeof(linea), f)) {
+        if (linea[0] != '#' && sscanf(linea, "%255s %d %d", h, &p, &hl) == 3 && strcmp(h, host) == 0 && p == procesos_nodo)
+            continue;
+        size_t n = strlen(linea);
+        if (largo + n + 1 > cap) nuevo = (char*) realloc(nuevo, cap = 2 * (largo + n + 1));
+        memcpy(nuevo + largo, linea, n);
+        largo += n;
+    }
+    if (largo + 300 > cap) nuevo = (char*) realloc(nuevo, cap = largo + 300);
+    largo += snprintf(nuevo + largo, cap - largo, "%s %d %d\n", host, procesos_nodo, hilos);
+
+    rewind(f);
+    if (ftruncate(fd, 0) == 0) fwrite(nuevo, 1, largo, f);
+    fflush(f);
+    flock(fd, LOCK_UN);
+    fclose(f);
+    free(nuevo);
+}
+
+// Calibración: todos los procesos del nodo corren a la vez una carga representativa
+// (grises y espejos fusionados más un blur) con cada cantidad de hilos candidata; gana
+// la de menor tiempo del proceso más lento del nodo.
+int topologia_calibrar(const TopologiaNodo* t, MPI_Comm nodo) {
+    int candidatos[4], n = 0;
+    int m = t->bloque_cpus;
+    int fisicos = m / (t->hilos_por_nucleo > 0 ? t->hilos_por_nucleo : 1);
+    int opciones[4] = { m, fisicos, m / 2, 1 };
+    for (int i = 0; i < 4; i++) {
+        int c = opciones[i] < 1 ? 1 : opciones[i];
+        int repetido = 0;
+        for (int j = 0; j < n; j++) repetido |= candidatos[j] == c;
+        if (!repetido) candidatos[n++] = c;
+    }
+
+    int ancho = 1921, alto = 1081, row_padded = (ancho * 3 + 3) & (~3);
+    size_t tam = (size_t)row_padded * alto;
+    unsigned char* src = (unsigned char*) malloc(tam);
+    unsigned char* dst[5];
+    for (int i = 0; i < 5; i++) dst[i] = (unsigned char*) malloc(tam);
+    unsigned int x = 12345u;
+    for (size_t i = 0; i < tam; i++) src[i] = (unsigned char)((x = x * 1664525u + 1013904223u) >> 24);
+
+    int mejor = candidatos[0];
+    double mejor_tiempo = -1;
+    for (int c = 0; c < n; c++) {
+        omp_set_num_threads(candidatos[c]);
+        topologia_fijar_hilos(t, candidatos[c]);
+        double tiempo = -1;
+        for (int r = 0; r < 3; r++) {
+            MPI_Barrier(nodo);
+            double t0 = omp_get_wtime();
+            grises_espejos_buffer(src, dst[0], dst[1], dst[2], dst[3], dst[4], ancho, alto, row_padded, 0);
+            blur_buffer(src, dst[0], ancho, alto, row_padded, 55);
+            double t_local = omp_get_wtime() - t0, t_nodo;
+            MPI_Allreduce(&t_local, &t_nodo, 1, MPI_DOUBLE, MPI_MAX, nodo);
+            if (tiempo < 0 || t_nodo < tiempo) tiempo = t_nodo;
+        }
+        if (mejor_tiempo < 0 || tiempo < mejor_tiempo) {
+            mejor_tiempo = tiempo;
+            mejor = candidatos[c];
+        }
+    }
+
+    free(src);
+    for (int i = 0; i < 5; i++) free(dst[i]);
+    return mejor;
+}
+
+// Colectiva sobre `comm`: fija la cantidad de hilos OpenMP del proceso y los fija a CPUs.
+void configurar_hilos_por_topologia(MPI_Comm comm) {
+    char hostname[256];
+    gethostname(hostname, sizeof(hostname));
+    hostname[sizeof(hostname) - 1] = '\0';
+
+    TopologiaNodo t;
+    MPI_Comm nodo;
+    topologia_leer(&t);
+    topologia_repartir(&t, comm, &nodo);
+
+    const char* env_hilos = getenv("FILTROS_HILOS");
+    if (!env_hilos || !env_hilos[0]) env_hilos = getenv("OMP_NUM_THREADS");
+    const char* env_calibrar = getenv("FILTROS_CALIBRAR");
+    int calibrar = env_calibrar && strcmp(env_calibrar, "1") == 0;
+
+    int hilos = env_hilos ? atoi(env_hilos) : 0;
+    const char* origen = "entorno";
+    if (hilos <= 0) {
+        hilos = 0;
+        // Todos los procesos del nodo deciden igual, así calibran juntos o ninguno
+        if (calibrar) {
+            hilos = topologia_calibrar(&t, nodo);
+            MPI_Bcast(&hilos, 1, MPI_INT, 0, nodo);
+            if (t.rank_nodo == 0) config_hilos_guardar(hostname, t.procesos_nodo, hilos);
+            origen = "calibración";
+        } else if ((hilos = config_hilos_leer(hostname, t.procesos_nodo)) > 0) {
+            origen = ruta_config_hilos();
+        } else {
+            hilos = t.bloque_cpus;
+            origen = "automático";
+        }
+    }
+    if (hilos < 1) hilos = 1;
+    MPI_Comm_free(&nodo);
+
+    omp_set_num_threads(hilos);
+    topologia_fijar_hilos(&t, hilos);
+
+    printf("Host %s usando %d hilos (OpenMP, %s): %d CPUs, %d núcleos x %d hilos, %d nodos NUMA, "
+           "%d procesos en el nodo, %d CPUs para este proceso\n",
+           hostname, hilos, origen, t.n_cpus, t.nucleos, t.hilos_por_nucleo, t.nodos_numa, t.procesos_nodo,
+           t.bloque_cpus);
+}
+
+#endif